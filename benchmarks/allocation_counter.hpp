@@ -0,0 +1,27 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef BENCHMARKS_ALLOCATION_COUNTER_HPP_
+#define BENCHMARKS_ALLOCATION_COUNTER_HPP_
+
+#include <cstddef>
+
+// Returns the number of times the global operator new (any form) has been
+// called in this process. Linking allocation_counter.cpp into a benchmark
+// replaces the global allocation functions with counting ones; they live in
+// their own translation unit so that the compiler cannot inline them into the
+// code being measured.
+size_t allocation_count();
+
+#endif  // BENCHMARKS_ALLOCATION_COUNTER_HPP_
@@ -0,0 +1,111 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+// Compares flat_map with the std maps it replaced in the clients' tables,
+// keyed by Key as the pending request and callback tables are.
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <unordered_map>
+
+#include "benchmark/benchmark.h"
+#include "types.hpp"
+
+namespace {
+
+vector<Key> make_keys(unsigned n) {
+  vector<Key> keys;
+  keys.reserve(n);
+  for (unsigned i = 0; i < n; i++) {
+    keys.push_back("key_" + std::to_string(i));
+  }
+  return keys;
+}
+
+template <typename M>
+void fill(M* map, const vector<Key>& keys) {
+  for (const Key& key : keys) {
+    (*map)[key] = key.size();
+  }
+}
+
+template <typename M>
+void BM_Insert(benchmark::State& state) {
+  vector<Key> keys = make_keys(state.range(0));
+
+  for (auto _ : state) {
+    M map;
+    fill(&map, keys);
+    benchmark::DoNotOptimize(map);
+  }
+
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <typename M>
+void BM_Lookup(benchmark::State& state) {
+  vector<Key> keys = make_keys(state.range(0));
+  M map;
+  fill(&map, keys);
+
+  // look keys up in a different order than they were inserted in
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+
+  for (auto _ : state) {
+    for (const Key& key : keys) {
+      benchmark::DoNotOptimize(map.find(key));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <typename M>
+void BM_Erase(benchmark::State& state) {
+  vector<Key> keys = make_keys(state.range(0));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    M map;
+    fill(&map, keys);
+    state.ResumeTiming();
+
+    for (const Key& key : keys) {
+      map.erase(key);
+    }
+    benchmark::DoNotOptimize(map);
+  }
+
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+using FlatMap = flat_map<Key, size_t>;
+using UnorderedMap = std::unordered_map<Key, size_t>;
+using OrderedMap = std::map<Key, size_t>;
+
+}  // namespace
+
+#define MAP_BENCHMARK(bm, map_type) \
+  BENCHMARK_TEMPLATE(bm, map_type)->RangeMultiplier(10)->Range(10000, 1000000)
+
+MAP_BENCHMARK(BM_Insert, FlatMap);
+MAP_BENCHMARK(BM_Insert, UnorderedMap);
+MAP_BENCHMARK(BM_Insert, OrderedMap);
+MAP_BENCHMARK(BM_Lookup, FlatMap);
+MAP_BENCHMARK(BM_Lookup, UnorderedMap);
+MAP_BENCHMARK(BM_Lookup, OrderedMap);
+MAP_BENCHMARK(BM_Erase, FlatMap);
+MAP_BENCHMARK(BM_Erase, UnorderedMap);
+MAP_BENCHMARK(BM_Erase, OrderedMap);
@@ -0,0 +1,95 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+// Counts the heap allocations made by lattice merges that copy the incoming
+// element (merge(const T&)) against merges that take it over (merge(T&&)).
+// The allocs_per_merge counter only covers the merge call itself.
+
+#include "allocation_counter.hpp"
+#include "benchmark/benchmark.h"
+#include "lattices/core_lattices.hpp"
+
+namespace {
+
+using StringSet = SetLattice<string>;
+using NestedMap = MapLattice<Key, SetLattice<string>>;
+
+// Builds an element with n entries; offset shifts the names so that two
+// elements built with offsets n / 2 apart share half of their entries.
+set<string> make_set(unsigned n, unsigned offset) {
+  set<string> s;
+  for (unsigned i = 0; i < n; i++) {
+    s.insert("value_" + std::to_string(i + offset));
+  }
+  return s;
+}
+
+map<Key, SetLattice<string>> make_map(unsigned n, unsigned offset) {
+  map<Key, SetLattice<string>> m;
+  for (unsigned i = 0; i < n; i++) {
+    m.emplace("key_" + std::to_string(i + offset), make_set(4, i));
+  }
+  return m;
+}
+
+template <typename L, typename T, bool Move>
+void run_merge(benchmark::State& state, T (*make)(unsigned, unsigned)) {
+  unsigned n = state.range(0);
+  size_t merge_allocations = 0;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    L lattice(make(n, 0));
+    T incoming = make(n, n / 2);
+    size_t before = allocation_count();
+    state.ResumeTiming();
+
+    if (Move) {
+      lattice.merge(std::move(incoming));
+    } else {
+      lattice.merge(incoming);
+    }
+
+    state.PauseTiming();
+    merge_allocations += allocation_count() - before;
+    benchmark::DoNotOptimize(lattice);
+    state.ResumeTiming();
+  }
+
+  state.counters["allocs_per_merge"] = benchmark::Counter(
+      merge_allocations, benchmark::Counter::kAvgIterations);
+}
+
+void BM_SetMergeCopy(benchmark::State& state) {
+  run_merge<StringSet, set<string>, false>(state, make_set);
+}
+
+void BM_SetMergeMove(benchmark::State& state) {
+  run_merge<StringSet, set<string>, true>(state, make_set);
+}
+
+void BM_MapMergeCopy(benchmark::State& state) {
+  run_merge<NestedMap, map<Key, SetLattice<string>>, false>(state, make_map);
+}
+
+void BM_MapMergeMove(benchmark::State& state) {
+  run_merge<NestedMap, map<Key, SetLattice<string>>, true>(state, make_map);
+}
+
+}  // namespace
+
+BENCHMARK(BM_SetMergeCopy)->RangeMultiplier(16)->Range(16, 4096);
+BENCHMARK(BM_SetMergeMove)->RangeMultiplier(16)->Range(16, 4096);
+BENCHMARK(BM_MapMergeCopy)->RangeMultiplier(16)->Range(16, 4096);
+BENCHMARK(BM_MapMergeMove)->RangeMultiplier(16)->Range(16, 4096);
@@ -0,0 +1,86 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+// Compares compare() against the check the causal lattices used to order two
+// clocks: copy the local clock, merge the incoming one into it, and test the
+// result for equality with both.
+
+#include "benchmark/benchmark.h"
+#include "lattices/vector_clock.hpp"
+
+namespace {
+
+ClockOrder merge_and_compare(const VectorClock &a, const VectorClock &b) {
+  VectorClock merged = a;
+  merged.merge(b);
+
+  bool ahead = !(merged == b);
+  bool behind = !(merged == a);
+  return to_clock_order(ahead, behind);
+}
+
+VectorClock make_clock(unsigned n) {
+  VectorClock clock;
+  for (unsigned i = 0; i < n; i++) {
+    clock.merge({{"node_" + std::to_string(i), i + 1}});
+  }
+  return clock;
+}
+
+// Returns a copy of clock that is ahead of it on the last node and, if
+// concurrent is set, behind it on the first.
+VectorClock bump(const VectorClock &clock, unsigned n, bool concurrent) {
+  map<string, MaxLattice<unsigned>> entries = clock.reveal();
+  entries["node_" + std::to_string(n - 1)] = n + 1;
+  if (concurrent) {
+    entries["node_0"] = 0;
+  }
+  return VectorClock(entries);
+}
+
+enum Relation { kEqual, kDominated, kConcurrent };
+
+template <ClockOrder (*Order)(const VectorClock &, const VectorClock &)>
+void BM_Order(benchmark::State &state) {
+  unsigned n = state.range(0);
+  VectorClock a = make_clock(n);
+  VectorClock b = a;
+
+  if (state.range(1) != kEqual) {
+    b = bump(a, n, state.range(1) == kConcurrent);
+  }
+
+  if (compare(a, b) != merge_and_compare(a, b)) {
+    state.SkipWithError("compare and merge_and_compare disagree");
+    return;
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Order(a, b));
+  }
+}
+
+void clock_args(benchmark::internal::Benchmark *bm) {
+  for (long relation : {kEqual, kDominated, kConcurrent}) {
+    for (long n = 4; n <= 256; n *= 4) {
+      bm->Args({n, relation});
+    }
+  }
+  bm->ArgNames({"nodes", "relation"});
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_Order, compare)->Apply(clock_args);
+BENCHMARK_TEMPLATE(BM_Order, merge_and_compare)->Apply(clock_args);
@@ -15,18 +15,39 @@
 #ifndef INCLUDE_ASYNC_CLIENT_HPP_
 #define INCLUDE_ASYNC_CLIENT_HPP_
 
+#include <stdexcept>
+
 #include "anna.pb.h"
+#include "client/kvs_future.hpp"
 #include "common.hpp"
+#include "deadline_queue.hpp"
+#include "hash_ring.hpp"
+#include "key_address_cache.hpp"
+#include "replica_selector.hpp"
 #include "requests.hpp"
 #include "threads.hpp"
 #include "types.hpp"
 
 using TimePoint = std::chrono::time_point<std::chrono::system_clock>;
 
-struct PendingRequest {
-  TimePoint tp_;
+// The fewest latency samples the hedging delay is estimated from.
+const unsigned kMinHedgeSamples = 32;
+
+// The size of the block the client's receive arena starts out on.
+const unsigned kReceiveArenaBlockSize = 64 * 1024;
+
+// How long a key that a server rejected bypasses the local hash ring.
+const std::chrono::seconds kHashRingBypassTtl(60);
+
+struct KvsPendingRequest {
   Address worker_addr_;
   KeyRequest request_;
+
+  // when the request was last sent to worker_addr_
+  Deadline sent_;
+
+  // the second replica a hedged read was sent to, if any
+  Address hedge_addr_;
 };
 
 class KvsClientInterface {
@@ -34,8 +55,45 @@ class KvsClientInterface {
   virtual string put_async(const Key& key, const string& payload,
                            LatticeType lattice_type) = 0;
   virtual void get_async(const Key& key) = 0;
+  virtual string put_batch_async(const vector<Key>& keys,
+                                 const vector<string>& payloads,
+                                 LatticeType lattice_type) = 0;
+  virtual void get_batch_async(const vector<Key>& keys) = 0;
   virtual vector<KeyResponse> receive_async() = 0;
+  virtual vector<KeyResponse> receive(std::chrono::milliseconds max_wait) = 0;
   virtual zmq::context_t* get_context() = 0;
+
+  // Variants of put_async and get_async that hand the response to callback
+  // from within the receive call that demultiplexes it, instead of returning
+  // it from that call.
+  virtual string put_async(const Key& key, const string& payload,
+                           LatticeType lattice_type,
+                           ResponseCallback callback) = 0;
+  virtual void get_async(const Key& key, ResponseCallback callback) = 0;
+
+  /**
+   * Issue a PUT and return a future for its response.
+   */
+  KvsFuture<KeyResponse> put(const Key& key, const string& payload,
+                             LatticeType lattice_type) {
+    KvsFuture<KeyResponse> future;
+    put_async(key, payload, lattice_type,
+              [future](const KeyResponse& response) mutable {
+                future.set_value(response);
+              });
+    return future;
+  }
+
+  /**
+   * Issue a GET and return a future for its response.
+   */
+  KvsFuture<KeyResponse> get(const Key& key) {
+    KvsFuture<KeyResponse> future;
+    get_async(key, [future](const KeyResponse& response) mutable {
+      future.set_value(response);
+    });
+    return future;
+  }
 };
 
 class KvsClient : public KvsClientInterface {
@@ -56,7 +114,9 @@ class KvsClient : public KvsClientInterface {
       key_address_puller_(zmq::socket_t(context_, ZMQ_PULL)),
       response_puller_(zmq::socket_t(context_, ZMQ_PULL)),
       log_(spdlog::basic_logger_mt("client_log", "client_log.txt", true)),
-      timeout_(timeout) {
+      timeout_(timeout),
+      hedge_percentile_(0),
+      hedge_min_delay_(0) {
     // initialize logger
     log_->flush_on(spdlog::level::info);
 
@@ -75,8 +135,23 @@ class KvsClient : public KvsClientInterface {
         {static_cast<void*>(response_puller_), 0, ZMQ_POLLIN, 0},
     };
 
+    client_id_ = get_client_id(ip, tid);
+
     // set the request ID to 0
     rid_ = 0;
+
+    receive_budget_ = kDefaultReceiveBudget;
+    received_count_ = 0;
+    address_query_window_ = std::chrono::milliseconds(0);
+    hash_ring_stale_ = false;
+
+    // Reset keeps the initial block, so a receive cycle only allocates from
+    // the heap once its messages outgrow it
+    arena_block_.resize(kReceiveArenaBlockSize);
+    google::protobuf::ArenaOptions arena_options;
+    arena_options.initial_block = arena_block_.data();
+    arena_options.initial_block_size = arena_block_.size();
+    arena_.reset(new google::protobuf::Arena(arena_options));
   }
 
   ~KvsClient() {}
@@ -87,14 +162,37 @@ class KvsClient : public KvsClientInterface {
    */
   string put_async(const Key& key, const string& payload,
                    LatticeType lattice_type) {
-    KeyRequest request;
-    KeyTuple* tuple = prepare_data_request(request, key);
-    request.set_type(RequestType::PUT);
-    tuple->set_lattice_type(lattice_type);
-    tuple->set_payload(payload);
+    return legacy_request_id(issue_put(key, payload, lattice_type, false));
+  }
 
-    try_request(request);
-    return request.request_id();
+  /**
+   * Issue an async PUT of a delta, as produced by serialize_delta, instead of
+   * the key's whole value. The server merges it into the stored value like
+   * any other payload. If the PUT fails, restore the delta into its
+   * DeltaTracker, or write the whole state with put_async. Only SET and
+   * ORDERED_SET values have deltas; other lattice types throw
+   * std::invalid_argument.
+   */
+  string put_delta_async(const Key& key, const string& delta,
+                         LatticeType lattice_type) {
+    if (lattice_type != LatticeType::SET &&
+        lattice_type != LatticeType::ORDERED_SET) {
+      throw std::invalid_argument("no delta PUTs for lattice type " +
+                                  LatticeType_Name(lattice_type));
+    }
+
+    return legacy_request_id(issue_put(key, delta, lattice_type, true));
+  }
+
+  /**
+   * Issue an async PUT request whose response is handed to callback instead
+   * of being returned from receive_async.
+   */
+  string put_async(const Key& key, const string& payload,
+                   LatticeType lattice_type, ResponseCallback callback) {
+    RequestId request_id = issue_put(key, payload, lattice_type, false);
+    put_callbacks_[std::make_pair(key, request_id)] = std::move(callback);
+    return legacy_request_id(request_id);
   }
 
   /**
@@ -109,151 +207,179 @@ class KvsClient : public KvsClientInterface {
       request.set_type(RequestType::GET);
 
       try_request(request);
+      flush_address_queries(false);
     }
   }
 
-  vector<KeyResponse> receive_async() {
-    vector<KeyResponse> result;
-    kZmqUtil->poll(0, &pollitems_);
-
-    if (pollitems_[0].revents & ZMQ_POLLIN) {
-      string serialized = kZmqUtil->recv_string(&key_address_puller_);
-      KeyAddressResponse response;
-      response.ParseFromString(serialized);
-      Key key = response.addresses(0).key();
-
-      if (pending_request_map_.find(key) != pending_request_map_.end()) {
-        if (response.error() == AnnaError::NO_SERVERS) {
-          log_->error(
-              "No servers have joined the cluster yet. Retrying request.");
-          pending_request_map_[key].first = std::chrono::system_clock::now();
-
-          query_routing_async(key);
-        } else {
-          // populate cache
-          for (const Address& ip : response.addresses(0).ips()) {
-            key_address_cache_[key].insert(ip);
-          }
+  /**
+   * Issue an async GET request whose response is handed to callback instead
+   * of being returned from receive_async. Every callback registered for a key
+   * while its GET is outstanding receives the same response.
+   */
+  void get_async(const Key& key, ResponseCallback callback) {
+    get_callbacks_[key].push_back(std::move(callback));
+    get_async(key);
+  }
 
-          // handle stuff in pending request map
-          for (auto& req : pending_request_map_[key].second) {
-            try_request(req);
-          }
+  /**
+   * Issue async PUT requests for a batch of keys; payloads[i] is written to
+   * keys[i]. Keys owned by the same worker thread are coalesced into a single
+   * KeyRequest. All of the requests share the returned request ID, and each
+   * key still gets its own response from receive_async. Responses are matched
+   * by key and request ID, so a key may appear only once per batch. A batch
+   * with a duplicate key, or with a different number of payloads than keys,
+   * throws std::invalid_argument before anything is sent.
+   */
+  string put_batch_async(const vector<Key>& keys,
+                         const vector<string>& payloads,
+                         LatticeType lattice_type) {
+    if (keys.size() != payloads.size()) {
+      throw std::invalid_argument("PUT batch has " +
+                                  std::to_string(keys.size()) + " keys but " +
+                                  std::to_string(payloads.size()) +
+                                  " payloads");
+    }
 
-          // GC the pending request map
-          pending_request_map_.erase(key);
-        }
+    set<Key> batched;
+    for (const Key& key : keys) {
+      if (!batched.insert(key).second) {
+        throw std::invalid_argument("duplicate key in PUT batch: " + key);
       }
     }
 
-    if (pollitems_[1].revents & ZMQ_POLLIN) {
-      string serialized = kZmqUtil->recv_string(&response_puller_);
-      KeyResponse response;
-      response.ParseFromString(serialized);
-      Key key = response.tuples(0).key();
+    RequestId request_id = get_request_id();
+    vector<KeyRequest> requests(keys.size());
 
-      if (response.type() == RequestType::GET) {
-        if (pending_get_response_map_.find(key) !=
-            pending_get_response_map_.end()) {
-          if (check_tuple(response.tuples(0))) {
-            // error no == 2, so re-issue request
-            pending_get_response_map_[key].tp_ =
-                std::chrono::system_clock::now();
-
-            try_request(pending_get_response_map_[key].request_);
-          } else {
-            // error no == 0 or 1
-            result.push_back(response);
-            pending_get_response_map_.erase(key);
-          }
-        }
-      } else {
-        if (pending_put_response_map_.find(key) !=
-                pending_put_response_map_.end() &&
-            pending_put_response_map_[key].find(response.response_id()) !=
-                pending_put_response_map_[key].end()) {
-          if (check_tuple(response.tuples(0))) {
-            // error no == 2, so re-issue request
-            pending_put_response_map_[key][response.response_id()].tp_ =
-                std::chrono::system_clock::now();
-
-            try_request(pending_put_response_map_[key][response.response_id()]
-                            .request_);
-          } else {
-            // error no == 0
-            result.push_back(response);
-            pending_put_response_map_[key].erase(response.response_id());
-
-            if (pending_put_response_map_[key].size() == 0) {
-              pending_put_response_map_.erase(key);
-            }
-          }
-        }
-      }
+    for (unsigned i = 0; i < keys.size(); i++) {
+      KeyTuple* tuple = prepare_data_request(requests[i], keys[i], request_id);
+      requests[i].set_type(RequestType::PUT);
+      tuple->set_lattice_type(lattice_type);
+      tuple->set_payload(payloads[i]);
     }
 
-    // GC the pending request map
-    set<Key> to_remove;
-    for (const auto& pair : pending_request_map_) {
-      if (std::chrono::duration_cast<std::chrono::milliseconds>(
-              std::chrono::system_clock::now() - pair.second.first)
-              .count() > timeout_) {
-        // query to the routing tier timed out
-        for (const auto& req : pair.second.second) {
-          result.push_back(generate_bad_response(req));
-        }
+    try_batch_request(requests);
+    flush_address_queries(false);
+    return legacy_request_id(request_id);
+  }
+
+  /**
+   * Issue async GET requests for a batch of keys. Keys owned by the same
+   * worker thread are coalesced into a single KeyRequest, and each key gets
+   * its own response from receive_async.
+   */
+  void get_batch_async(const vector<Key>& keys) {
+    RequestId request_id = get_request_id();
+    vector<KeyRequest> requests;
+    set<Key> batched;
 
-        to_remove.insert(pair.first);
+    for (const Key& key : keys) {
+      // we issue GET only when it is not in the pending map
+      if (pending_get_response_map_.find(key) ==
+              pending_get_response_map_.end() &&
+          batched.insert(key).second) {
+        requests.push_back(KeyRequest());
+        prepare_data_request(requests.back(), key, request_id);
+        requests.back().set_type(RequestType::GET);
       }
     }
 
-    for (const Key& key : to_remove) {
-      pending_request_map_.erase(key);
-    }
+    try_batch_request(requests);
+    flush_address_queries(false);
+  }
 
-    // GC the pending get response map
-    to_remove.clear();
-    for (const auto& pair : pending_get_response_map_) {
-      if (std::chrono::duration_cast<std::chrono::milliseconds>(
-              std::chrono::system_clock::now() - pair.second.tp_)
-              .count() > timeout_) {
-        // query to server timed out
-        result.push_back(generate_bad_response(pair.second.request_));
-        to_remove.insert(pair.first);
-        invalidate_cache_for_worker(pair.second.worker_addr_);
+  /**
+   * Look up the worker threads of every key that is neither cached nor
+   * already being looked up, so that later requests for them do not wait on
+   * the routing tier. The lookups are sent right away, in as few
+   * KeyAddressRequests as possible.
+   */
+  void prefetch_addresses(const vector<Key>& keys) {
+    for (const Key& key : keys) {
+      if (key_address_cache_.address_count(key) == 0 &&
+          pending_request_map_.find(key) == pending_request_map_.end()) {
+        query_routing_async(key);
       }
     }
 
-    for (const Key& key : to_remove) {
-      pending_get_response_map_.erase(key);
-    }
+    flush_address_queries(true);
+  }
 
-    // GC the pending put response map
-    map<Key, set<string>> to_remove_put;
-    for (const auto& key_map_pair : pending_put_response_map_) {
-      for (const auto& id_map_pair :
-           pending_put_response_map_[key_map_pair.first]) {
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::system_clock::now() -
-                pending_put_response_map_[key_map_pair.first][id_map_pair.first]
-                    .tp_)
-                .count() > timeout_) {
-          result.push_back(generate_bad_response(id_map_pair.second.request_));
-          to_remove_put[key_map_pair.first].insert(id_map_pair.first);
-          invalidate_cache_for_worker(id_map_pair.second.worker_addr_);
-        }
-      }
-    }
+  /**
+   * Set how long routing lookups for cold keys are held back so that lookups
+   * issued close together share one KeyAddressRequest. With the default of 0,
+   * only the lookups made by a single call (e.g., get_batch_async) share a
+   * request.
+   */
+  void set_address_query_window(std::chrono::milliseconds window) {
+    address_query_window_ = window;
+  }
 
-    for (const auto& key_set_pair : to_remove_put) {
-      for (const auto& id : key_set_pair.second) {
-        pending_put_response_map_[key_set_pair.first].erase(id);
-      }
+  /**
+   * Place cold keys on storage threads locally, with the servers' consistent
+   * hashing scheme, instead of asking the routing tier. membership is called
+   * now, and again after a server rejects a request or a worker times out,
+   * to get the current storage nodes. A key that a server has rejected is
+   * looked up through the routing tier for the next kHashRingBypassTtl, since
+   * it may have non-default replication.
+   */
+  void enable_local_routing(MembershipSource membership,
+                            unsigned threads_per_node,
+                            unsigned global_replication = 1,
+                            unsigned local_replication = 1) {
+    membership_source_ = std::move(membership);
+    hash_ring_.reset(new ClientHashRing(threads_per_node, global_replication,
+                                        local_replication));
+    hash_ring_->set_members(membership_source_());
+    hash_ring_stale_ = false;
+    hash_ring_bypass_.clear();
+  }
+
+  vector<KeyResponse> receive_async() {
+    vector<KeyResponse> result;
+    received_count_ = receive_ready(result);
+    expire_requests(result);
+    flush_address_queries(false);
+    return dispatch_callbacks(result);
+  }
+
+  /**
+   * A blocking version of receive_async. It waits for up to max_wait until a
+   * response arrives or the earliest pending request times out, whichever
+   * comes first, and then handles every message that is ready.
+   */
+  vector<KeyResponse> receive(std::chrono::milliseconds max_wait) {
+    vector<KeyResponse> result;
+    received_count_ = 0;
+
+    if (kZmqUtil->poll(get_poll_timeout(max_wait).count(), &pollitems_) > 0) {
+      received_count_ = receive_ready(result);
     }
 
-    return result;
+    expire_requests(result);
+    flush_address_queries(false);
+    return dispatch_callbacks(result);
+  }
+
+  /**
+   * Add a file descriptor to the set that receive waits on, so that another
+   * thread can cut a blocking receive short by making it readable. The caller
+   * owns the descriptor and is responsible for draining it.
+   */
+  void add_wakeup_fd(int fd) {
+    pollitems_.push_back({nullptr, fd, ZMQ_POLLIN, 0});
   }
 
+  /**
+   * Set the maximum number of messages handled by one receive call; anything
+   * beyond that stays queued for the next call.
+   */
+  void set_receive_budget(unsigned budget) { receive_budget_ = budget; }
+
+  /**
+   * Return the number of messages handled by the last receive call.
+   */
+  unsigned get_received_count() { return received_count_; }
+
   /**
    * Set the logger used by the client.
    */
@@ -264,6 +390,49 @@ class KvsClient : public KvsClientInterface {
    */
   void clear_cache() { key_address_cache_.clear(); }
 
+  /**
+   * Return the key address cache, e.g. to size it or to read its hit, miss
+   * and eviction counters.
+   */
+  KeyAddressCache& get_key_address_cache() { return key_address_cache_; }
+
+  /**
+   * Set how the replica a request is sent to is picked among the worker
+   * threads responsible for its key.
+   */
+  void set_replica_policy(ReplicaPolicy policy) {
+    replica_selector_.set_policy(policy);
+  }
+
+  /**
+   * Return the per-worker latency and load tracker behind replica selection.
+   */
+  const ReplicaSelector& get_replica_selector() { return replica_selector_; }
+
+  /**
+   * Send a GET that has not been answered after the given percentile of
+   * recent response latencies, but at least min_delay, to a second replica as
+   * well; the first response wins. Only keys with more than one cached
+   * replica are hedged, and only once enough latencies have been measured.
+   */
+  void enable_hedged_reads(
+      double percentile = 0.95,
+      std::chrono::microseconds min_delay = std::chrono::milliseconds(1)) {
+    hedge_percentile_ = percentile;
+    hedge_min_delay_ = min_delay;
+  }
+
+  void disable_hedged_reads() {
+    hedge_percentile_ = 0;
+    hedge_timer_.clear();
+  }
+
+  /**
+   * Return the cache of sockets to the storage and routing threads, e.g. to
+   * bound it, tune its socket options or read its send counters.
+   */
+  SocketCache& get_socket_cache() { return socket_cache_; }
+
   /**
    * Return the ZMQ context used by this client.
    */
@@ -275,6 +444,213 @@ class KvsClient : public KvsClientInterface {
   unsigned get_seed() { return seed_; }
 
  private:
+  /**
+   * Drains both receiving sockets without blocking, alternating between them,
+   * until neither has a message left or receive_budget_ messages have been
+   * handled. Returns the number of messages handled.
+   *
+   * Routing responses are only needed while they are handled, so they are
+   * parsed onto arena_, which is reset once the cycle is over. Key responses
+   * are parsed there too; only the tuples that complete a request are copied
+   * into heap-allocated responses in result, so duplicate, late and hedged
+   * answers never touch the heap.
+   */
+  unsigned receive_ready(vector<KeyResponse>& result) {
+    unsigned count = 0;
+    bool drained = false;
+    zmq::message_t message;
+
+    while (!drained && count < receive_budget_) {
+      drained = true;
+
+      if (kZmqUtil->try_recv_message(&key_address_puller_, &message)) {
+        KeyAddressResponse* response =
+            google::protobuf::Arena::CreateMessage<KeyAddressResponse>(
+                arena_.get());
+        parse_from_message(message, response);
+        handle_key_address_response(*response);
+        drained = false;
+        count++;
+      }
+
+      if (count < receive_budget_ &&
+          kZmqUtil->try_recv_message(&response_puller_, &message)) {
+        KeyResponse* response =
+            google::protobuf::Arena::CreateMessage<KeyResponse>(arena_.get());
+        parse_from_message(message, response);
+        handle_key_response(response, result);
+        drained = false;
+        count++;
+      }
+    }
+
+    arena_->Reset();
+    return count;
+  }
+
+  /**
+   * Populates the key address cache from a routing tier response and issues
+   * the requests that were waiting on it.
+   */
+  void handle_key_address_response(const KeyAddressResponse& response) {
+    if (response.error() == AnnaError::NO_SERVERS) {
+      log_->error("No servers have joined the cluster yet. Retrying request.");
+    }
+
+    // a response answers every key of a batched lookup
+    for (const auto& key_address : response.addresses()) {
+      const Key& key = key_address.key();
+      bool pending =
+          pending_request_map_.find(key) != pending_request_map_.end();
+
+      if (response.error() == AnnaError::NO_SERVERS) {
+        if (pending) {
+          pending_request_timer_.schedule(key, get_deadline());
+          query_routing_async(key);
+        }
+        continue;
+      }
+
+      // populate cache; this includes keys that were only prefetched
+      for (const Address& ip : key_address.ips()) {
+        key_address_cache_.add(key, ip);
+      }
+
+      if (pending) {
+        // handle stuff in pending request map; the entry is detached first
+        // because try_request may add to the map again
+        vector<KeyRequest> requests = std::move(pending_request_map_[key]);
+        pending_request_map_.erase(key);
+        pending_request_timer_.cancel(key);
+
+        for (auto& req : requests) {
+          try_request(req);
+        }
+      }
+    }
+  }
+
+  /**
+   * Matches a response from a storage server against the pending requests.
+   */
+  void handle_key_response(KeyResponse* response,
+                           vector<KeyResponse>& result) {
+    restore_response_ids(response);
+
+    // responses to batched requests carry one tuple per key; each of them is
+    // handled and returned as if it had been requested on its own
+    for (const KeyTuple& tuple : response->tuples()) {
+      handle_response(*response, tuple, result);
+    }
+  }
+
+  /**
+   * Fails every pending request whose deadline has passed; the clock is read
+   * once per call.
+   */
+  void expire_requests(vector<KeyResponse>& result) {
+    Deadline now = SteadyClock::now();
+
+    // GC the pending request map
+    for (const Key& key : pending_request_timer_.expire(now)) {
+      // query to the routing tier timed out
+      for (auto& req : pending_request_map_[key]) {
+        result.push_back(generate_bad_response(std::move(req)));
+      }
+
+      pending_request_map_.erase(key);
+    }
+
+    // GC the pending get response map
+    for (const Key& key : get_response_timer_.expire(now)) {
+      // query to server timed out
+      KvsPendingRequest& pending = pending_get_response_map_[key];
+      result.push_back(generate_bad_response(std::move(pending.request_)));
+      if (!pending.worker_addr_.empty()) {
+        invalidate_cache_for_worker(pending.worker_addr_);
+      }
+      settle(pending, false);
+      pending_get_response_map_.erase(key);
+      hedge_timer_.cancel(key);
+    }
+
+    // GC the pending put response map
+    for (const auto& key_id_pair : put_response_timer_.expire(now)) {
+      auto& id_map = pending_put_response_map_[key_id_pair.first];
+      KvsPendingRequest& pending = id_map[key_id_pair.second];
+      result.push_back(generate_bad_response(std::move(pending.request_)));
+      if (!pending.worker_addr_.empty()) {
+        invalidate_cache_for_worker(pending.worker_addr_);
+      }
+      settle(pending, false);
+      id_map.erase(key_id_pair.second);
+
+      if (id_map.size() == 0) {
+        pending_put_response_map_.erase(key_id_pair.first);
+      }
+    }
+
+    for (const Key& key : hedge_timer_.expire(now)) {
+      send_hedge(key);
+    }
+  }
+
+  /**
+   * Hands each response that has callbacks registered for it to those
+   * callbacks and returns the remaining responses. Callbacks may issue new
+   * requests but must not call receive.
+   */
+  vector<KeyResponse> dispatch_callbacks(vector<KeyResponse>& responses) {
+    if (get_callbacks_.empty() && put_callbacks_.empty()) {
+      return std::move(responses);
+    }
+
+    vector<KeyResponse> unclaimed;
+
+    for (KeyResponse& response : responses) {
+      Key key = response.tuples(0).key();
+      vector<ResponseCallback> callbacks;
+
+      if (response.type() == RequestType::GET) {
+        auto it = get_callbacks_.find(key);
+        if (it != get_callbacks_.end()) {
+          callbacks = std::move(it->second);
+          get_callbacks_.erase(it);
+        }
+      } else {
+        auto it =
+            put_callbacks_.find(std::make_pair(key, response.response_rid()));
+        if (it != put_callbacks_.end()) {
+          callbacks.push_back(std::move(it->second));
+          put_callbacks_.erase(it);
+        }
+      }
+
+      if (callbacks.empty()) {
+        unclaimed.push_back(std::move(response));
+      }
+
+      for (const ResponseCallback& callback : callbacks) {
+        callback(response);
+      }
+    }
+
+    return unclaimed;
+  }
+
+  /**
+   * Caps max_wait at the time left until the earliest pending deadline.
+   */
+  std::chrono::milliseconds get_poll_timeout(
+      std::chrono::milliseconds max_wait) {
+    Deadline now = SteadyClock::now();
+    max_wait = pending_request_timer_.cap_wait(now, max_wait);
+    max_wait = get_response_timer_.cap_wait(now, max_wait);
+    max_wait = address_query_timer_.cap_wait(now, max_wait);
+    max_wait = hedge_timer_.cap_wait(now, max_wait);
+    return put_response_timer_.cap_wait(now, max_wait);
+  }
+
   /**
    * A recursive helper method for the get and put implementations that tries
    * to issue a request at most trial_limit times before giving up. It  checks
@@ -291,38 +667,253 @@ class KvsClient : public KvsClientInterface {
     Address worker = get_worker_thread(key);
     if (worker.length() == 0) {
       // this means a key addr request is issued asynchronously
-      if (pending_request_map_.find(key) == pending_request_map_.end()) {
-        pending_request_map_[key].first = std::chrono::system_clock::now();
-      }
-      pending_request_map_[key].second.push_back(request);
+      defer_request(request);
       return;
     }
 
     request.mutable_tuples(0)->set_address_cache_size(
-        key_address_cache_[key].size());
+        key_address_cache_.address_count(key));
 
     send_request<KeyRequest>(request, socket_cache_[worker]);
+    track_request(request, worker);
+  }
+
+  /**
+   * The batched counterpart of try_request. Each request in the batch holds a
+   * single key; the requests whose keys share a worker thread are merged into
+   * one KeyRequest. Every key is still tracked separately, so retries and
+   * timeouts apply to individual keys.
+   */
+  void try_batch_request(vector<KeyRequest>& requests) {
+    map<Address, KeyRequest> batches;
+
+    for (KeyRequest& request : requests) {
+      Key key = request.tuples(0).key();
+      Address worker = get_worker_thread(key);
+      if (worker.length() == 0) {
+        defer_request(request);
+        continue;
+      }
+
+      request.mutable_tuples(0)->set_address_cache_size(
+          key_address_cache_.address_count(key));
+
+      KeyRequest& batch = batches[worker];
+      if (batch.tuples_size() == 0) {
+        batch.set_type(request.type());
+        batch.set_request_rid(request.request_rid());
+        batch.set_request_id(request.request_id());
+        batch.set_response_address(request.response_address());
+      }
+      *batch.add_tuples() = request.tuples(0);
+
+      track_request(request, worker);
+    }
+
+    for (const auto& pair : batches) {
+      send_request<KeyRequest>(pair.second, socket_cache_[pair.first]);
+    }
+  }
+
+  /**
+   * Parks a request until the routing tier tells us which worker threads are
+   * responsible for its key.
+   */
+  void defer_request(const KeyRequest& request) {
+    Key key = request.tuples(0).key();
+    if (pending_request_map_.find(key) == pending_request_map_.end()) {
+      pending_request_timer_.schedule(key, get_deadline());
+    }
+    pending_request_map_[key].push_back(request);
+  }
+
+  /**
+   * Records a request that was sent to worker in the pending GET or PUT map,
+   * starting its timeout if this is the first time it is sent.
+   */
+  void track_request(const KeyRequest& request, const Address& worker) {
+    Key key = request.tuples(0).key();
+    KvsPendingRequest* pending;
 
     if (request.type() == RequestType::GET) {
       if (pending_get_response_map_.find(key) ==
           pending_get_response_map_.end()) {
-        pending_get_response_map_[key].tp_ = std::chrono::system_clock::now();
+        get_response_timer_.schedule(key, get_deadline());
         pending_get_response_map_[key].request_ = request;
+        schedule_hedge(key);
+      }
+
+      pending = &pending_get_response_map_[key];
+    } else {
+      pending = &pending_put_response_map_[key][request.request_rid()];
+      if (pending->request_.tuples_size() == 0) {
+        put_response_timer_.schedule(std::make_pair(key, request.request_rid()),
+                                     get_deadline());
+        pending->request_ = request;
       }
+    }
+
+    // only the latest send of a request is ever settled, so one that is still
+    // unanswered, e.g. a second GET for a key whose GET is pending, is
+    // abandoned here; otherwise its worker would stay outstanding for good
+    if (!pending->worker_addr_.empty()) {
+      replica_selector_.on_abandon(pending->worker_addr_);
+    }
+    if (!pending->hedge_addr_.empty()) {
+      replica_selector_.on_abandon(pending->hedge_addr_);
+      pending->hedge_addr_.clear();
+    }
+
+    pending->worker_addr_ = worker;
+    pending->sent_ = SteadyClock::now();
+    replica_selector_.on_send(worker);
+  }
+
+  /**
+   * Updates the replica stats for a request that has been answered or has
+   * timed out, and marks it as no longer sent anywhere.
+   */
+  void settle(KvsPendingRequest& pending, bool answered) {
+    if (pending.worker_addr_.empty()) {
+      return;
+    }
+
+    if (!pending.hedge_addr_.empty()) {
+      // either replica may have answered, so neither gets a latency sample
+      replica_selector_.on_abandon(pending.worker_addr_);
+      replica_selector_.on_abandon(pending.hedge_addr_);
+    } else if (answered) {
+      replica_selector_.on_response(
+          pending.worker_addr_,
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              SteadyClock::now() - pending.sent_));
+    } else {
+      replica_selector_.on_timeout(pending.worker_addr_,
+                                   std::chrono::milliseconds(timeout_));
+    }
+
+    pending.worker_addr_.clear();
+    pending.hedge_addr_.clear();
+  }
+
+  /**
+   * Starts the hedging delay of a GET to key that has just been sent, if
+   * hedged reads are enabled and the delay can be estimated.
+   */
+  void schedule_hedge(const Key& key) {
+    if (hedge_percentile_ <= 0 ||
+        replica_selector_.sample_count() < kMinHedgeSamples) {
+      return;
+    }
+
+    std::chrono::microseconds delay =
+        std::max(hedge_min_delay_,
+                 replica_selector_.latency_percentile(hedge_percentile_));
+    hedge_timer_.schedule(key, SteadyClock::now() + delay);
+  }
+
+  /**
+   * Sends the pending GET to key to a second replica, if it is still waiting
+   * on its first one and another replica is cached.
+   */
+  void send_hedge(const Key& key) {
+    auto it = pending_get_response_map_.find(key);
+    if (it == pending_get_response_map_.end()) {
+      return;
+    }
+
+    KvsPendingRequest& pending = it->second;
+    const set<Address>* addresses = key_address_cache_.peek(key);
+    if (pending.worker_addr_.empty() || !pending.hedge_addr_.empty() ||
+        addresses == nullptr) {
+      return;
+    }
+
+    Address hedge =
+        replica_selector_.select(*addresses, &seed_, pending.worker_addr_);
+    if (hedge.empty()) {
+      return;
+    }
+
+    send_request<KeyRequest>(pending.request_, socket_cache_[hedge]);
+    pending.hedge_addr_ = hedge;
+    replica_selector_.on_send(hedge);
+  }
+
+  /**
+   * Matches one tuple of a KeyResponse against the pending GET and PUT maps.
+   * Completed requests are appended to result as single-tuple responses;
+   * requests the server rejected with errno == 2 are reissued.
+   */
+  void handle_response(const KeyResponse& response, const KeyTuple& tuple,
+                       vector<KeyResponse>& result) {
+    Key key = tuple.key();
+    RequestId rid = response.response_rid();
 
-      pending_get_response_map_[key].worker_addr_ = worker;
+    if (response.type() == RequestType::GET) {
+      if (pending_get_response_map_.find(key) !=
+          pending_get_response_map_.end()) {
+        KvsPendingRequest& pending = pending_get_response_map_[key];
+        settle(pending, true);
+
+        if (check_tuple(tuple)) {
+          // error no == 2, so re-issue request
+          get_response_timer_.schedule(key, get_deadline());
+
+          try_request(pending.request_);
+        } else {
+          // error no == 0 or 1
+          result.push_back(copy_response(response, tuple));
+          pending_get_response_map_.erase(key);
+          get_response_timer_.cancel(key);
+          hedge_timer_.cancel(key);
+        }
+      }
     } else {
-      if (pending_put_response_map_[key].find(request.request_id()) ==
-          pending_put_response_map_[key].end()) {
-        pending_put_response_map_[key][request.request_id()].tp_ =
-            std::chrono::system_clock::now();
-        pending_put_response_map_[key][request.request_id()].request_ = request;
+      if (pending_put_response_map_.find(key) !=
+              pending_put_response_map_.end() &&
+          pending_put_response_map_[key].find(rid) !=
+              pending_put_response_map_[key].end()) {
+        KvsPendingRequest& pending = pending_put_response_map_[key][rid];
+        settle(pending, true);
+
+        if (check_tuple(tuple)) {
+          // error no == 2, so re-issue request
+          put_response_timer_.schedule(std::make_pair(key, rid),
+                                       get_deadline());
+
+          try_request(pending.request_);
+        } else {
+          // error no == 0
+          result.push_back(copy_response(response, tuple));
+          pending_put_response_map_[key].erase(rid);
+          put_response_timer_.cancel(std::make_pair(key, rid));
+
+          if (pending_put_response_map_[key].size() == 0) {
+            pending_put_response_map_.erase(key);
+          }
+        }
       }
-      pending_put_response_map_[key][request.request_id()].worker_addr_ =
-          worker;
     }
   }
 
+  /**
+   * Copies the header of response and one of its tuples off the receive
+   * arena into a heap-allocated response that can outlive the cycle.
+   */
+  KeyResponse copy_response(const KeyResponse& response,
+                            const KeyTuple& tuple) {
+    KeyResponse single;
+    single.set_type(response.type());
+    single.set_response_rid(response.response_rid());
+    if (!response.response_id().empty()) {
+      single.set_response_id(response.response_id());
+    }
+    single.set_error(response.error());
+    *single.add_tuples() = tuple;
+    return single;
+  }
+
   /**
    * A helper method to check for the default failure modes for a request that
    * retrieves a response. It returns true if the caller method should reissue
@@ -337,12 +928,12 @@ class KvsClient : public KvsClientInterface {
           "Retrying request.",
           key);
 
-      invalidate_cache_for_key(key, tuple);
+      invalidate_cache_for_key(key);
       return true;
     }
 
     if (tuple.invalidate()) {
-      invalidate_cache_for_key(key, tuple);
+      invalidate_cache_for_key(key);
 
       log_->info("Server ordered invalidation of key address cache for key {}",
                  key);
@@ -353,12 +944,18 @@ class KvsClient : public KvsClientInterface {
 
   /**
    * When a server thread tells us to invalidate the cache for a key it's
-   * because we likely have out of date information for that key; it sends us
-   * the updated information for that key, and update our cache with that
-   * information.
+   * because we likely have out of date information for that key; drop it so
+   * that the next request for the key asks the routing tier again, and keep
+   * the key off the local hash ring for a while.
    */
-  void invalidate_cache_for_key(const Key& key, const KeyTuple& tuple) {
+  void invalidate_cache_for_key(const Key& key) {
     key_address_cache_.erase(key);
+
+    if (hash_ring_ != nullptr) {
+      hash_ring_bypass_.schedule(key,
+                                 SteadyClock::now() + kHashRingBypassTtl);
+      hash_ring_stale_ = true;
+    }
   }
 
   /**
@@ -368,25 +965,25 @@ class KvsClient : public KvsClientInterface {
    * the key we were querying and any other key.
    */
   void invalidate_cache_for_worker(const Address& worker) {
-    vector<string> tokens;
-    split(worker, ':', tokens);
-    string signature = tokens[1];
-    set<Key> remove_set;
-
-    for (const auto& key_pair : key_address_cache_) {
-      for (const string& address : key_pair.second) {
-        vector<string> v;
-        split(address, ':', v);
-
-        if (v[1] == signature) {
-          remove_set.insert(key_pair.first);
-        }
-      }
-    }
+    key_address_cache_.invalidate_node(worker);
+    hash_ring_stale_ = true;
+  }
 
-    for (const string& key : remove_set) {
-      key_address_cache_.erase(key);
-    }
+  /**
+   * Send a PUT of payload for key; delta marks the payload as a delta.
+   */
+  RequestId issue_put(const Key& key, const string& payload,
+                      LatticeType lattice_type, bool delta) {
+    KeyRequest request;
+    KeyTuple* tuple = prepare_data_request(request, key);
+    request.set_type(RequestType::PUT);
+    tuple->set_lattice_type(lattice_type);
+    tuple->set_payload(payload);
+    tuple->set_delta(delta);
+
+    try_request(request);
+    flush_address_queries(false);
+    return request.request_rid();
   }
 
   /**
@@ -396,7 +993,13 @@ class KvsClient : public KvsClientInterface {
    * request.
    */
   KeyTuple* prepare_data_request(KeyRequest& request, const Key& key) {
-    request.set_request_id(get_request_id());
+    return prepare_data_request(request, key, get_request_id());
+  }
+
+  KeyTuple* prepare_data_request(KeyRequest& request, const Key& key,
+                                 RequestId request_id) {
+    request.set_request_rid(request_id);
+    request.set_request_id(legacy_request_id(request_id));
     request.set_response_address(ut_.response_connect_address());
 
     KeyTuple* tp = request.add_tuples();
@@ -411,30 +1014,66 @@ class KvsClient : public KvsClientInterface {
    * NULL is returned.
    */
   set<Address> get_all_worker_threads(const Key& key) {
-    if (key_address_cache_.find(key) == key_address_cache_.end() ||
-        key_address_cache_[key].size() == 0) {
+    const set<Address>* addresses = find_worker_threads(key);
+    return addresses == nullptr ? set<Address>() : *addresses;
+  }
+
+  /**
+   * Similar to the previous method, but only returns one worker address,
+   * picked according to the replica policy, instead of all of them.
+   */
+  Address get_worker_thread(const Key& key) {
+    const set<Address>* addresses = find_worker_threads(key);
+
+    // This will be null if the worker threads are not cached locally
+    if (addresses == nullptr) {
+      return "";
+    }
+
+    return replica_selector_.select(*addresses, &seed_);
+  }
+
+  /**
+   * Looks up the cached worker threads for key without copying them. On a
+   * miss, the routing tier is queried and nullptr is returned.
+   */
+  const set<Address>* find_worker_threads(const Key& key) {
+    const set<Address>* addresses = key_address_cache_.get(key);
+    if ((addresses == nullptr || addresses->size() == 0) &&
+        hash_ring_ != nullptr) {
+      addresses = place_locally(key);
+    }
+
+    if (addresses == nullptr || addresses->size() == 0) {
       if (pending_request_map_.find(key) == pending_request_map_.end()) {
         query_routing_async(key);
       }
-      return set<Address>();
-    } else {
-      return key_address_cache_[key];
+      return nullptr;
     }
+
+    return addresses;
   }
 
   /**
-   * Similar to the previous method, but only returns one (randomly chosen)
-   * worker address instead of all of them.
+   * Caches the worker threads that the local hash ring assigns to key and
+   * returns them, or returns nullptr if key has to go to the routing tier.
    */
-  Address get_worker_thread(const Key& key) {
-    set<Address> local_cache = get_all_worker_threads(key);
+  const set<Address>* place_locally(const Key& key) {
+    hash_ring_bypass_.expire(SteadyClock::now());
+    if (hash_ring_bypass_.contains(key)) {
+      return nullptr;
+    }
 
-    // This will be empty if the worker threads are not cached locally
-    if (local_cache.size() == 0) {
-      return "";
+    if (hash_ring_stale_) {
+      hash_ring_->set_members(membership_source_());
+      hash_ring_stale_ = false;
+    }
+
+    for (const Address& address : hash_ring_->responsible_threads(key)) {
+      key_address_cache_.add(key, address);
     }
 
-    return *(next(begin(local_cache), rand_r(&seed_) % local_cache.size()));
+    return key_address_cache_.peek(key);
   }
 
   /**
@@ -448,35 +1087,74 @@ class KvsClient : public KvsClientInterface {
   }
 
   /**
-   * Send a query to the routing tier asynchronously.
+   * Queue a query to the routing tier; it is sent, along with the other
+   * queued keys, by the next flush_address_queries call that finds the batch
+   * full or its window over.
    */
   void query_routing_async(const Key& key) {
-    // define protobuf request objects
-    KeyAddressRequest request;
+    if (!queued_address_keys_.insert(key).second) {
+      return;
+    }
+
+    if (address_queries_.keys_size() == 0) {
+      address_query_timer_.schedule(0, SteadyClock::now() +
+                                           address_query_window_);
+    }
+    address_queries_.add_keys(key);
+  }
+
+  /**
+   * Send the queued routing queries as a single KeyAddressRequest to one
+   * routing thread if force is set, the batch is full, or its window is over.
+   */
+  void flush_address_queries(bool force) {
+    if (address_queries_.keys_size() == 0) {
+      return;
+    }
+
+    if (!force &&
+        static_cast<unsigned>(address_queries_.keys_size()) <
+            kMaxKeyAddressBatch &&
+        address_query_timer_.expire(SteadyClock::now()).empty()) {
+      return;
+    }
 
     // populate request with response address, request id, etc.
-    request.set_request_id(get_request_id());
-    request.set_response_address(ut_.key_address_connect_address());
-    request.add_keys(key);
+    RequestId request_id = get_request_id();
+    address_queries_.set_request_rid(request_id);
+    address_queries_.set_request_id(legacy_request_id(request_id));
+    address_queries_.set_response_address(ut_.key_address_connect_address());
 
     Address rt_thread = get_routing_thread();
-    send_request<KeyAddressRequest>(request, socket_cache_[rt_thread]);
+    send_request<KeyAddressRequest>(address_queries_, socket_cache_[rt_thread]);
+
+    address_queries_.Clear();
+    queued_address_keys_.clear();
+    address_query_timer_.clear();
   }
 
   /**
    * Generates a unique request ID.
    */
-  string get_request_id() {
-    if (++rid_ % 10000 == 0) rid_ = 0;
-    return ut_.ip() + ":" + std::to_string(ut_.tid()) + "_" +
-           std::to_string(rid_++);
+  RequestId get_request_id() { return make_request_id(client_id_, rid_++); }
+
+  /**
+   * Returns the deadline for a request that is issued or retried now.
+   */
+  Deadline get_deadline() {
+    return SteadyClock::now() + std::chrono::milliseconds(timeout_);
   }
 
-  KeyResponse generate_bad_response(const KeyRequest& req) {
+  /**
+   * Builds the TIMEOUT response for a request that is being dropped; a PUT's
+   * payload is moved out of req rather than copied.
+   */
+  KeyResponse generate_bad_response(KeyRequest&& req) {
     KeyResponse resp;
 
     resp.set_type(req.type());
     resp.set_response_id(req.request_id());
+    resp.set_response_rid(req.request_rid());
     resp.set_error(AnnaError::TIMEOUT);
 
     KeyTuple* tp = resp.add_tuples();
@@ -484,7 +1162,7 @@ class KvsClient : public KvsClientInterface {
 
     if (req.type() == RequestType::PUT) {
       tp->set_lattice_type(req.tuples(0).lattice_type());
-      tp->set_payload(req.tuples(0).payload());
+      tp->set_payload(std::move(*req.mutable_tuples(0)->mutable_payload()));
     }
 
     return resp;
@@ -494,8 +1172,11 @@ class KvsClient : public KvsClientInterface {
   // the set of routing addresses outside the cluster
   vector<UserRoutingThread> routing_threads_;
 
+  // the high half of this client's request IDs
+  uint32_t client_id_;
+
   // the current request id
-  unsigned rid_;
+  uint32_t rid_;
 
   // the random seed for this client
   unsigned seed_;
@@ -516,7 +1197,7 @@ class KvsClient : public KvsClientInterface {
   vector<zmq::pollitem_t> pollitems_;
 
   // cache for retrieved worker addresses organized by key
-  map<Key, set<Address>> key_address_cache_;
+  KeyAddressCache key_address_cache_;
 
   // class logger
   logger log_;
@@ -524,14 +1205,70 @@ class KvsClient : public KvsClientInterface {
   // GC timeout
   unsigned timeout_;
 
+  // the maximum number of messages handled per receive call
+  unsigned receive_budget_;
+
+  // the number of messages handled by the last receive call
+  unsigned received_count_;
+
+  // holds the messages parsed during one receive cycle, and the block it
+  // starts out on
+  vector<char> arena_block_;
+  std::unique_ptr<google::protobuf::Arena> arena_;
+
   // keeps track of pending requests due to missing worker address
-  map<Key, pair<TimePoint, vector<KeyRequest>>> pending_request_map_;
+  flat_map<Key, vector<KeyRequest>> pending_request_map_;
 
   // keeps track of pending get responses
-  map<Key, PendingRequest> pending_get_response_map_;
+  flat_map<Key, KvsPendingRequest> pending_get_response_map_;
 
   // keeps track of pending put responses
-  map<Key, map<string, PendingRequest>> pending_put_response_map_;
+  flat_map<Key, flat_map<RequestId, KvsPendingRequest>>
+      pending_put_response_map_;
+
+  // callbacks waiting on GET responses, by key
+  map<Key, vector<ResponseCallback>> get_callbacks_;
+
+  // callbacks waiting on PUT responses, by key and request ID
+  hmap<pair<Key, RequestId>, ResponseCallback, pair_hash> put_callbacks_;
+
+  // timeouts for the three pending maps above
+  DeadlineQueue<Key> pending_request_timer_;
+  DeadlineQueue<Key> get_response_timer_;
+  DeadlineQueue<pair<Key, RequestId>, pair_hash> put_response_timer_;
+
+  // routing queries waiting to be sent in one KeyAddressRequest, and their
+  // keys
+  KeyAddressRequest address_queries_;
+  set<Key> queued_address_keys_;
+
+  // the end of the current batch's window, under the ID 0
+  DeadlineQueue<unsigned> address_query_timer_;
+
+  // how long routing queries are held back to be batched
+  std::chrono::milliseconds address_query_window_;
+
+  // places cold keys when local routing is enabled; null otherwise
+  std::unique_ptr<ClientHashRing> hash_ring_;
+
+  // where the hash ring's membership comes from, and whether it has to be
+  // pulled again before the ring is next used
+  MembershipSource membership_source_;
+  bool hash_ring_stale_;
+
+  // keys that go to the routing tier until their deadline
+  DeadlineQueue<Key> hash_ring_bypass_;
+
+  // per-worker latency and load, used to pick replicas
+  ReplicaSelector replica_selector_;
+
+  // the latency percentile after which a GET is hedged, or 0 if hedging is
+  // off, and the shortest hedging delay
+  double hedge_percentile_;
+  std::chrono::microseconds hedge_min_delay_;
+
+  // when each pending GET is due to be hedged
+  DeadlineQueue<Key> hedge_timer_;
 };
 
 #endif  // INCLUDE_ASYNC_CLIENT_HPP_
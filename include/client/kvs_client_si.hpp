@@ -12,11 +12,12 @@
 //  See the License for the specific language governing permissions and
 //  limitations under the License.
 
-#ifndef INCLUDE_ASYNC_CLIENT_HPP_
-#define INCLUDE_ASYNC_CLIENT_HPP_
+#ifndef INCLUDE_CLIENT_KVS_CLIENT_SI_HPP_
+#define INCLUDE_CLIENT_KVS_CLIENT_SI_HPP_
 
 #include "anna.pb.h"
 #include "common.hpp"
+#include "deadline_queue.hpp"
 #include "requests.hpp"
 #include "threads.hpp"
 #include "types.hpp"
@@ -24,7 +25,6 @@
 using TimePoint = std::chrono::time_point<std::chrono::system_clock>;
 
 struct PendingRequest {
-  TimePoint tp_;
   Address worker_addr_;
   KeyRequest request_;
 };
@@ -35,6 +35,7 @@ class KvsSIClientInterface {
                            LatticeType lattice_type, uint64_t snapshot) = 0;
   virtual void get_async(const Key& key, const uint64_t& snapshot) = 0;
   virtual vector<KeyResponse> receive_async() = 0;
+  virtual vector<KeyResponse> receive(std::chrono::milliseconds max_wait) = 0;
   virtual zmq::context_t* get_context() = 0;
 };
 
@@ -75,8 +76,13 @@ class KvsSIClient : public KvsSIClientInterface {
         {static_cast<void*>(response_puller_), 0, ZMQ_POLLIN, 0},
     };
 
+    client_id_ = get_client_id(ip, tid);
+
     // set the request ID to 0
     rid_ = 0;
+
+    receive_budget_ = kDefaultReceiveBudget;
+    received_count_ = 0;
   }
 
   ~KvsSIClient() {}
@@ -118,181 +124,240 @@ class KvsSIClient : public KvsSIClientInterface {
 
   vector<KeyResponse> receive_async() {
     vector<KeyResponse> result;
-    kZmqUtil->poll(0, &pollitems_);
+    received_count_ = receive_ready(result);
+    expire_requests(result);
+    return result;
+  }
+
+  /**
+   * A blocking version of receive_async. It waits for up to max_wait until a
+   * response arrives or the earliest pending request times out, whichever
+   * comes first, and then handles every message that is ready.
+   */
+  vector<KeyResponse> receive(std::chrono::milliseconds max_wait) {
+    vector<KeyResponse> result;
+    received_count_ = 0;
 
-    if (pollitems_[0].revents & ZMQ_POLLIN) {
-      string serialized = kZmqUtil->recv_string(&key_address_puller_);
-      KeyAddressResponse response;
-      response.ParseFromString(serialized);
-      Key key = response.addresses(0).key();
+    if (kZmqUtil->poll(get_poll_timeout(max_wait).count(), &pollitems_) > 0) {
+      received_count_ = receive_ready(result);
+    }
 
-      if (pending_request_map_.find(key) != pending_request_map_.end()) {
-        if (response.error() == AnnaError::NO_SERVERS) {
-          log_->error(
-              "No servers have joined the cluster yet. Retrying request.");
-          pending_request_map_[key].first = std::chrono::system_clock::now();
+    expire_requests(result);
+    return result;
+  }
 
-          query_routing_async(key);
-        } else {
-          // populate cache
-          // We choose one which will be chosen for read your writes
-          key_address_cache_[key].insert(response.addresses(0).ips()[rand() % response.addresses(0).ips().size()]);
-          /*
-          for (const Address& ip : response.addresses(0).ips()) {
-            key_address_cache_[key].insert(ip);
-          }
-          */
-          // handle stuff in pending request map
-          for (auto& req : pending_request_map_[key].second) {
-            try_request(req, req.snapshot());
-          }
+  /**
+   * Set the maximum number of messages handled by one receive call; anything
+   * beyond that stays queued for the next call.
+   */
+  void set_receive_budget(unsigned budget) { receive_budget_ = budget; }
+
+  /**
+   * Return the number of messages handled by the last receive call.
+   */
+  unsigned get_received_count() { return received_count_; }
+
+  /**
+   * Set the logger used by the client.
+   */
+  void set_logger(logger log) { log_ = log; }
+
+  /**
+   * Clears the key address cache held by this client.
+   */
+  void clear_cache() { key_address_cache_.clear(); }
+
+  /**
+   * Return the ZMQ context used by this client.
+   */
+  zmq::context_t* get_context() { return &context_; }
 
-          // GC the pending request map
-          pending_request_map_.erase(key);
+  /**
+   * Return the random seed used by this client.
+   */
+  unsigned get_seed() { return seed_; }
+
+ private:
+  /**
+   * Drains both receiving sockets without blocking, alternating between them,
+   * until neither has a message left or receive_budget_ messages have been
+   * handled. Returns the number of messages handled.
+   */
+  unsigned receive_ready(vector<KeyResponse>& result) {
+    unsigned count = 0;
+    bool drained = false;
+    zmq::message_t message;
+
+    while (!drained && count < receive_budget_) {
+      drained = true;
+
+      if (kZmqUtil->try_recv_message(&key_address_puller_, &message)) {
+        KeyAddressResponse response;
+        parse_from_message(message, &response);
+        handle_key_address_response(response);
+        drained = false;
+        count++;
+      }
+
+      if (count < receive_budget_ &&
+          kZmqUtil->try_recv_message(&response_puller_, &message)) {
+        KeyResponse response;
+        parse_from_message(message, &response);
+        restore_response_ids(&response);
+        handle_key_response(response, result);
+        drained = false;
+        count++;
+      }
+    }
+
+    return count;
+  }
+
+  /**
+   * Populates the key address cache from a routing tier response and issues
+   * the requests that were waiting on it.
+   */
+  void handle_key_address_response(const KeyAddressResponse& response) {
+    Key key = response.addresses(0).key();
+
+    if (pending_request_map_.find(key) != pending_request_map_.end()) {
+      if (response.error() == AnnaError::NO_SERVERS) {
+        log_->error(
+            "No servers have joined the cluster yet. Retrying request.");
+        pending_request_timer_.schedule(key, get_deadline());
+
+        query_routing_async(key);
+      } else {
+        // populate cache
+        // We choose one which will be chosen for read your writes
+        key_address_cache_[key].insert(response.addresses(0).ips()[rand() % response.addresses(0).ips().size()]);
+        /*
+        for (const Address& ip : response.addresses(0).ips()) {
+          key_address_cache_[key].insert(ip);
+        }
+        */
+        // handle stuff in pending request map; the entry is detached first
+        // because try_request may add to the map again
+        vector<KeyRequest> requests = std::move(pending_request_map_[key]);
+        pending_request_map_.erase(key);
+        pending_request_timer_.cancel(key);
+
+        for (auto& req : requests) {
+          try_request(req, req.snapshot());
         }
       }
     }
+  }
 
-    if (pollitems_[1].revents & ZMQ_POLLIN) {
-      string serialized = kZmqUtil->recv_string(&response_puller_);
-      KeyResponse response;
-      response.ParseFromString(serialized);
-      Key key = response.tuples(0).key();
-      uint64_t snapshot = response.snapshot();
-
-      if (response.type() == RequestType::GET) {
-          // Checks if we have any request for that key with the specific snapshot
-        if (pending_get_response_map_.find(key) != pending_get_response_map_.end() &&
-            pending_get_response_map_[key].find(snapshot) != pending_get_response_map_[key].end()) {
-          if (check_tuple(response.tuples(0))) {
-            // error no == 2, so re-issue request
-            pending_get_response_map_[key][response.snapshot()].tp_ =
-                std::chrono::system_clock::now();
-
-            try_request(pending_get_response_map_[key][snapshot].request_, snapshot);
-          } else {
-            // error no == 0 or 1
-            result.push_back(response);
-            pending_get_response_map_[key].erase(snapshot);
-            if (pending_get_response_map_[key].empty()){
-                pending_get_response_map_.erase(key);
-            }
+  /**
+   * Matches a response from a storage server against the pending requests.
+   */
+  void handle_key_response(const KeyResponse& response,
+                           vector<KeyResponse>& result) {
+    Key key = response.tuples(0).key();
+    uint64_t snapshot = response.snapshot();
+
+    if (response.type() == RequestType::GET) {
+        // Checks if we have any request for that key with the specific snapshot
+      if (pending_get_response_map_.find(key) != pending_get_response_map_.end() &&
+          pending_get_response_map_[key].find(snapshot) != pending_get_response_map_[key].end()) {
+        if (check_tuple(response.tuples(0))) {
+          // error no == 2, so re-issue request
+          get_response_timer_.schedule(std::make_pair(key, snapshot),
+                                       get_deadline());
+
+          try_request(pending_get_response_map_[key][snapshot].request_, snapshot);
+        } else {
+          // error no == 0 or 1
+          result.push_back(response);
+          pending_get_response_map_[key].erase(snapshot);
+          get_response_timer_.cancel(std::make_pair(key, snapshot));
+          if (pending_get_response_map_[key].empty()){
+              pending_get_response_map_.erase(key);
           }
         }
-      } else {
-        if (pending_put_response_map_.find(key) !=
-                pending_put_response_map_.end() &&
-            pending_put_response_map_[key].find(response.response_id()) !=
-                pending_put_response_map_[key].end()) {
-          if (check_tuple(response.tuples(0))) {
-            // error no == 2, so re-issue request
-            pending_put_response_map_[key][response.response_id()].tp_ =
-                std::chrono::system_clock::now();
-
-            try_request(pending_put_response_map_[key][response.response_id()]
-                            .request_, snapshot);
-          } else {
-            // error no == 0
-            result.push_back(response);
-            pending_put_response_map_[key].erase(response.response_id());
-
-            if (pending_put_response_map_[key].size() == 0) {
-              pending_put_response_map_.erase(key);
-            }
+      }
+    } else {
+      if (pending_put_response_map_.find(key) !=
+              pending_put_response_map_.end() &&
+          pending_put_response_map_[key].find(response.response_rid()) !=
+              pending_put_response_map_[key].end()) {
+        if (check_tuple(response.tuples(0))) {
+          // error no == 2, so re-issue request
+          put_response_timer_.schedule(
+              std::make_pair(key, response.response_rid()), get_deadline());
+
+          try_request(pending_put_response_map_[key][response.response_rid()]
+                          .request_, snapshot);
+        } else {
+          // error no == 0
+          result.push_back(response);
+          pending_put_response_map_[key].erase(response.response_rid());
+          put_response_timer_.cancel(
+              std::make_pair(key, response.response_rid()));
+
+          if (pending_put_response_map_[key].size() == 0) {
+            pending_put_response_map_.erase(key);
           }
         }
       }
     }
+  }
 
-    // GC the pending request map
-    set<Key> to_remove;
-    for (const auto& pair : pending_request_map_) {
-      if (std::chrono::duration_cast<std::chrono::milliseconds>(
-              std::chrono::system_clock::now() - pair.second.first)
-              .count() > timeout_) {
-        // query to the routing tier timed out
-        for (const auto& req : pair.second.second) {
-          result.push_back(generate_bad_response(req));
-        }
+  /**
+   * Fails every pending request whose deadline has passed; the clock is read
+   * once per call.
+   */
+  void expire_requests(vector<KeyResponse>& result) {
+    Deadline now = SteadyClock::now();
 
-        to_remove.insert(pair.first);
+    // GC the pending request map
+    for (const Key& key : pending_request_timer_.expire(now)) {
+      // query to the routing tier timed out
+      for (const auto& req : pending_request_map_[key]) {
+        result.push_back(generate_bad_response(req));
       }
-    }
 
-    for (const Key& key : to_remove) {
       pending_request_map_.erase(key);
     }
 
     // GC the pending get response map
-    to_remove.clear();
-    map<Key, set<uint64_t>> remove_pending_reads;
-    for (const auto& pair : pending_get_response_map_) {
-        for (const auto& version_request : pair.second){
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(
-                    std::chrono::system_clock::now() - version_request.second.tp_)
-                        .count() > timeout_) {
-                // query to server timed out
-                result.push_back(generate_bad_response(version_request.second.request_));
-                remove_pending_reads[pair.first].insert(version_request.first);
-                //invalidate_cache_for_worker(version_request.second.worker_addr_);
-            }
-        }
-    }
-
-    // removes pending read requests
-    for (const auto & pair : remove_pending_reads) {
-        for (const auto & snapshot : pair.second){
-            pending_get_response_map_[pair.first].erase(snapshot);
-        }
-    }
-
-    // GC the pending put response map
-    map<Key, set<string>> to_remove_put;
-    for (const auto& key_map_pair : pending_put_response_map_) {
-      for (const auto& id_map_pair :
-           pending_put_response_map_[key_map_pair.first]) {
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::system_clock::now() -
-                pending_put_response_map_[key_map_pair.first][id_map_pair.first]
-                    .tp_)
-                .count() > timeout_) {
-          result.push_back(generate_bad_response(id_map_pair.second.request_));
-          to_remove_put[key_map_pair.first].insert(id_map_pair.first);
-          //invalidate_cache_for_worker(id_map_pair.second.worker_addr_);
-        }
+    for (const auto& key_snapshot_pair : get_response_timer_.expire(now)) {
+      // query to server timed out
+      auto& snapshot_map = pending_get_response_map_[key_snapshot_pair.first];
+      const PendingRequest& pending = snapshot_map[key_snapshot_pair.second];
+      result.push_back(generate_bad_response(pending.request_));
+      snapshot_map.erase(key_snapshot_pair.second);
+
+      if (snapshot_map.empty()) {
+        pending_get_response_map_.erase(key_snapshot_pair.first);
       }
     }
 
-    for (const auto& key_set_pair : to_remove_put) {
-      for (const auto& id : key_set_pair.second) {
-        pending_put_response_map_[key_set_pair.first].erase(id);
+    // GC the pending put response map
+    for (const auto& key_id_pair : put_response_timer_.expire(now)) {
+      auto& id_map = pending_put_response_map_[key_id_pair.first];
+      const PendingRequest& pending = id_map[key_id_pair.second];
+      result.push_back(generate_bad_response(pending.request_));
+      id_map.erase(key_id_pair.second);
+
+      if (id_map.size() == 0) {
+        pending_put_response_map_.erase(key_id_pair.first);
       }
     }
-
-    return result;
   }
 
   /**
-   * Set the logger used by the client.
-   */
-  void set_logger(logger log) { log_ = log; }
-
-  /**
-   * Clears the key address cache held by this client.
-   */
-  void clear_cache() { key_address_cache_.clear(); }
-
-  /**
-   * Return the ZMQ context used by this client.
-   */
-  zmq::context_t* get_context() { return &context_; }
-
-  /**
-   * Return the random seed used by this client.
+   * Caps max_wait at the time left until the earliest pending deadline.
    */
-  unsigned get_seed() { return seed_; }
+  std::chrono::milliseconds get_poll_timeout(
+      std::chrono::milliseconds max_wait) {
+    Deadline now = SteadyClock::now();
+    max_wait = pending_request_timer_.cap_wait(now, max_wait);
+    max_wait = get_response_timer_.cap_wait(now, max_wait);
+    return put_response_timer_.cap_wait(now, max_wait);
+  }
 
- private:
   /**
    * A recursive helper method for the get and put implementations that tries
    * to issue a request at most trial_limit times before giving up. It  checks
@@ -310,9 +375,9 @@ class KvsSIClient : public KvsSIClientInterface {
     if (worker.length() == 0) {
       // this means a key addr request is issued asynchronously
       if (pending_request_map_.find(key) == pending_request_map_.end()) {
-        pending_request_map_[key].first = std::chrono::system_clock::now();
+        pending_request_timer_.schedule(key, get_deadline());
       }
-      pending_request_map_[key].second.push_back(request);
+      pending_request_map_[key].push_back(request);
       return;
     }
 
@@ -325,27 +390,27 @@ class KvsSIClient : public KvsSIClientInterface {
       if (pending_get_response_map_.find(key) ==
           pending_get_response_map_.end() ) {
           map<uint64_t, PendingRequest> new_request;
-          new_request[snapshot].tp_ = std::chrono::system_clock::now();
           new_request[snapshot].request_ = request;
           pending_get_response_map_[key] = new_request;
+          get_response_timer_.schedule(std::make_pair(key, snapshot), get_deadline());
       } else if (pending_get_response_map_[key].find(snapshot) ==
                  pending_get_response_map_[key].end()){
-          pending_get_response_map_[key][snapshot].tp_ = std::chrono::system_clock::now();
           pending_get_response_map_[key][snapshot].request_ = request;
+          get_response_timer_.schedule(std::make_pair(key, snapshot), get_deadline());
       }
 
       pending_get_response_map_[key][snapshot].worker_addr_ = worker;
     } else {
         if (pending_put_response_map_.find(key) == pending_put_response_map_.end()){
-            map<string, PendingRequest> new_request;
-            new_request[request.request_id()].tp_ = std::chrono::system_clock::now();
-            new_request[request.request_id()].request_ = request;
+            map<RequestId, PendingRequest> new_request;
+            new_request[request.request_rid()].request_ = request;
             pending_put_response_map_[key] = new_request;
-        } else if (pending_put_response_map_[key].find(request.request_id()) == pending_put_response_map_[key].end()) {
-            pending_put_response_map_[key][request.request_id()].tp_ = std::chrono::system_clock::now();
-            pending_put_response_map_[key][request.request_id()].request_ = request;
+            put_response_timer_.schedule(std::make_pair(key, request.request_rid()), get_deadline());
+        } else if (pending_put_response_map_[key].find(request.request_rid()) == pending_put_response_map_[key].end()) {
+            pending_put_response_map_[key][request.request_rid()].request_ = request;
+            put_response_timer_.schedule(std::make_pair(key, request.request_rid()), get_deadline());
         }
-        pending_put_response_map_[key][request.request_id()].worker_addr_ = worker;
+        pending_put_response_map_[key][request.request_rid()].worker_addr_ = worker;
     }
   }
 
@@ -422,7 +487,9 @@ class KvsSIClient : public KvsSIClientInterface {
    * request.
    */
   KeyTuple* prepare_data_request(KeyRequest& request, const Key& key) {
-    request.set_request_id(get_request_id());
+    RequestId request_id = get_request_id();
+    request.set_request_rid(request_id);
+    request.set_request_id(legacy_request_id(request_id));
     request.set_response_address(ut_.response_connect_address());
 
     KeyTuple* tp = request.add_tuples();
@@ -481,7 +548,9 @@ class KvsSIClient : public KvsSIClientInterface {
     KeyAddressRequest request;
 
     // populate request with response address, request id, etc.
-    request.set_request_id(get_request_id());
+    RequestId request_id = get_request_id();
+    request.set_request_rid(request_id);
+    request.set_request_id(legacy_request_id(request_id));
     request.set_response_address(ut_.key_address_connect_address());
     request.add_keys(key);
 
@@ -492,10 +561,13 @@ class KvsSIClient : public KvsSIClientInterface {
   /**
    * Generates a unique request ID.
    */
-  string get_request_id() {
-    if (++rid_ % 10000 == 0) rid_ = 0;
-    return ut_.ip() + ":" + std::to_string(ut_.tid()) + "_" +
-           std::to_string(rid_++);
+  RequestId get_request_id() { return make_request_id(client_id_, rid_++); }
+
+  /**
+   * Returns the deadline for a request that is issued or retried now.
+   */
+  Deadline get_deadline() {
+    return SteadyClock::now() + std::chrono::milliseconds(timeout_);
   }
 
   KeyResponse generate_bad_response(const KeyRequest& req) {
@@ -503,6 +575,7 @@ class KvsSIClient : public KvsSIClientInterface {
 
     resp.set_type(req.type());
     resp.set_response_id(req.request_id());
+    resp.set_response_rid(req.request_rid());
     resp.set_error(AnnaError::TIMEOUT);
 
     KeyTuple* tp = resp.add_tuples();
@@ -524,8 +597,11 @@ class KvsSIClient : public KvsSIClientInterface {
   // the set of routing addresses outside the cluster
   vector<UserRoutingThread> routing_threads_;
 
+  // the high half of this client's request IDs
+  uint32_t client_id_;
+
   // the current request id
-  unsigned rid_;
+  uint32_t rid_;
 
   // the random seed for this client
   unsigned seed_;
@@ -554,14 +630,25 @@ class KvsSIClient : public KvsSIClientInterface {
   // GC timeout
   unsigned timeout_;
 
+  // the maximum number of messages handled per receive call
+  unsigned receive_budget_;
+
+  // the number of messages handled by the last receive call
+  unsigned received_count_;
+
   // keeps track of pending requests due to missing worker address
-  map<Key, pair<TimePoint, vector<KeyRequest>>> pending_request_map_;
+  map<Key, vector<KeyRequest>> pending_request_map_;
 
   // keeps track of pending get responses
   map<Key, map<uint64_t, PendingRequest>> pending_get_response_map_;
 
   // keeps track of pending put responses
-  map<Key, map<string, PendingRequest>> pending_put_response_map_;
+  map<Key, map<RequestId, PendingRequest>> pending_put_response_map_;
+
+  // timeouts for the three pending maps above
+  DeadlineQueue<Key> pending_request_timer_;
+  DeadlineQueue<pair<Key, uint64_t>, pair_hash> get_response_timer_;
+  DeadlineQueue<pair<Key, RequestId>, pair_hash> put_response_timer_;
 };
 
-#endif  // INCLUDE_ASYNC_CLIENT_HPP_
+#endif  // INCLUDE_CLIENT_KVS_CLIENT_SI_HPP_
@@ -0,0 +1,194 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_CLIENT_KVS_COROUTINE_HPP_
+#define INCLUDE_CLIENT_KVS_COROUTINE_HPP_
+
+// Coroutine support is only compiled in under C++20; older standards still
+// get the callback and KvsFuture interfaces of the clients.
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define KVS_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef KVS_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+
+#include "client/kvs_client.hpp"
+#include "client/kvs_future.hpp"
+#include "conflict_manager_client/conflict_manager_client.h"
+
+// Makes every KvsFuture awaitable, so that a coroutine can write
+//
+//   KeyResponse response = co_await client.get(key);
+//   KeyResponse read = co_await cm.get_key(keys, snapshot);
+//   CommitResponse done = co_await cm.commit(keys, payloads, type, snapshot);
+//
+// The coroutine is resumed from within the receive call that completes the
+// request, on the thread that drives the client.
+template <typename T>
+class KvsAwaiter {
+ public:
+  explicit KvsAwaiter(KvsFuture<T> future) : future_(std::move(future)) {}
+
+  bool await_ready() const { return future_.ready(); }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    future_.on_ready([handle](const T&) { handle.resume(); });
+  }
+
+  T await_resume() const { return future_.get(); }
+
+ private:
+  KvsFuture<T> future_;
+};
+
+template <typename T>
+KvsAwaiter<T> operator co_await(KvsFuture<T> future) {
+  return KvsAwaiter<T>(std::move(future));
+}
+
+template <typename T>
+class KvsTask;
+
+// Shared by the promise types of KvsTask: tasks start running as soon as they
+// are called and free their frame when they finish, reporting their result
+// through a KvsFuture.
+template <typename T>
+struct KvsTaskPromiseBase {
+  std::suspend_never initial_suspend() noexcept { return {}; }
+  std::suspend_never final_suspend() noexcept { return {}; }
+
+  // there is no thread to propagate the exception to
+  void unhandled_exception() { std::terminate(); }
+
+  KvsFuture<T> future_;
+};
+
+// The return type of coroutines that drive the clients, e.g. one
+// transaction of a function executor:
+//
+//   KvsTask<CommitResponse> run_txn(ConflictManagerClientInterface& cm,
+//                                   uint64_t snapshot) {
+//     KeyResponse read = co_await cm.get_key(read_set, snapshot);
+//     ...
+//     co_return co_await cm.commit(keys, payloads, LatticeType::LWW, snapshot);
+//   }
+//
+// A task can itself be awaited by another coroutine, or run to completion by
+// a KvsEventLoop.
+template <typename T>
+class KvsTask {
+ public:
+  struct promise_type : KvsTaskPromiseBase<T> {
+    KvsTask get_return_object() { return KvsTask(this->future_); }
+    void return_value(T value) { this->future_.set_value(std::move(value)); }
+  };
+
+  bool ready() const { return future_.ready(); }
+
+  // Only valid once ready() returns true.
+  const T& get() const { return future_.get(); }
+
+  KvsAwaiter<T> operator co_await() const { return KvsAwaiter<T>(future_); }
+
+ private:
+  explicit KvsTask(KvsFuture<T> future) : future_(std::move(future)) {}
+
+  KvsFuture<T> future_;
+};
+
+template <>
+class KvsTask<void> {
+ public:
+  struct promise_type : KvsTaskPromiseBase<bool> {
+    KvsTask get_return_object() { return KvsTask(this->future_); }
+    void return_void() { this->future_.set_value(true); }
+  };
+
+  bool ready() const { return future_.ready(); }
+
+  void get() const {}
+
+  KvsAwaiter<bool> operator co_await() const {
+    return KvsAwaiter<bool>(future_);
+  }
+
+ private:
+  explicit KvsTask(KvsFuture<bool> future) : future_(std::move(future)) {}
+
+  KvsFuture<bool> future_;
+};
+
+// A KvsEventLoop multiplexes any number of KvsTasks over the clients added to
+// it, on the calling thread. Each turn of the loop blocks on the first client
+// for up to poll_interval ms and then checks the others without blocking;
+// completed requests resume the coroutines waiting on them from inside those
+// receive calls. Responses to requests that were not issued through the
+// future interfaces have nobody waiting on them and are dropped.
+class KvsEventLoop {
+ public:
+  explicit KvsEventLoop(unsigned poll_interval = 1) :
+      poll_interval_(poll_interval) {}
+
+  void add(KvsClientInterface* client) {
+    pollers_.push_back([client](std::chrono::milliseconds wait) {
+      client->receive(wait);
+    });
+  }
+
+  void add(ConflictManagerClientInterface* client) {
+    pollers_.push_back([client](std::chrono::milliseconds wait) {
+      client->receive(wait);
+      client->receive_commit(std::chrono::milliseconds(0));
+    });
+  }
+
+  /**
+   * Run one turn of the loop.
+   */
+  void poll() {
+    std::chrono::milliseconds wait(poll_interval_);
+
+    for (const auto& poller : pollers_) {
+      poller(wait);
+      wait = std::chrono::milliseconds(0);
+    }
+  }
+
+  /**
+   * Run the loop until task has completed, and return its result.
+   */
+  template <typename T>
+  decltype(auto) run(const KvsTask<T>& task) {
+    while (!task.ready()) {
+      poll();
+    }
+
+    return task.get();
+  }
+
+ private:
+  // the longest time in ms that one turn of the loop blocks
+  unsigned poll_interval_;
+
+  vector<std::function<void(std::chrono::milliseconds)>> pollers_;
+};
+
+#endif  // KVS_HAS_COROUTINES
+
+#endif  // INCLUDE_CLIENT_KVS_COROUTINE_HPP_
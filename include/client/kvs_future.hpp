@@ -0,0 +1,133 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_CLIENT_KVS_FUTURE_HPP_
+#define INCLUDE_CLIENT_KVS_FUTURE_HPP_
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "types.hpp"
+
+template <typename T>
+class KvsFuture;
+
+// Maps the return type of a continuation to the future returned by `then`;
+// continuations that return a future are flattened rather than nested.
+template <typename R>
+struct FutureOf {
+  using type = KvsFuture<R>;
+};
+
+template <typename U>
+struct FutureOf<KvsFuture<U>> {
+  using type = KvsFuture<U>;
+};
+
+// A KvsFuture is a single-threaded future for the asynchronous clients. It is
+// fulfilled from inside the client's receive call on the thread that drives
+// the client, so there is nothing to block on: callers attach callbacks with
+// `on_ready`, or chain further work with `then`. Copies share state, and the
+// client fulfills a future through its `set_value`. An example:
+//
+//   client.get("a").then([&](const KeyResponse& a) {
+//     // issue a read that depends on the first one
+//     return client.get(a.tuples(0).payload());
+//   }).on_ready([](const KeyResponse& b) { ... });
+//
+//   while (...) client.receive_async();
+template <typename T>
+class KvsFuture {
+ public:
+  KvsFuture() : state_(std::make_shared<State>()) {}
+
+  bool ready() const { return state_->ready_; }
+
+  // Only valid once ready() returns true.
+  const T& get() const { return state_->value_; }
+
+  void set_value(T value) {
+    state_->value_ = std::move(value);
+    state_->ready_ = true;
+
+    // callbacks may attach more callbacks, so detach the list first
+    vector<std::function<void(const T&)>> callbacks =
+        std::move(state_->callbacks_);
+    state_->callbacks_.clear();
+
+    for (const auto& callback : callbacks) {
+      callback(state_->value_);
+    }
+  }
+
+  // Runs callback with the value once it is set, or right away if it already
+  // is.
+  void on_ready(std::function<void(const T&)> callback) {
+    if (state_->ready_) {
+      callback(state_->value_);
+    } else {
+      state_->callbacks_.push_back(std::move(callback));
+    }
+  }
+
+  // Returns a future for f applied to the value. If f returns a KvsFuture
+  // (e.g., a dependent read), the returned future completes with the result
+  // of that future. Use on_ready for continuations that return nothing.
+  template <typename F>
+  typename FutureOf<typename std::decay<decltype(
+      std::declval<F&>()(std::declval<const T&>()))>::type>::type
+  then(F f) {
+    using R = typename std::decay<decltype(f(std::declval<const T&>()))>::type;
+    static_assert(!std::is_void<R>::value,
+                  "use on_ready for continuations that return nothing");
+
+    typename FutureOf<R>::type next;
+    on_ready([f, next](const T& value) mutable {
+      Continuation<R>::run(f, value, next);
+    });
+
+    return next;
+  }
+
+ private:
+  struct State {
+    bool ready_ = false;
+    T value_;
+    vector<std::function<void(const T&)>> callbacks_;
+  };
+
+  template <typename R, typename Dummy = void>
+  struct Continuation {
+    template <typename F>
+    static void run(F& f, const T& value, KvsFuture<R> next) {
+      next.set_value(f(value));
+    }
+  };
+
+  template <typename U, typename Dummy>
+  struct Continuation<KvsFuture<U>, Dummy> {
+    template <typename F>
+    static void run(F& f, const T& value, KvsFuture<U> next) {
+      f(value).on_ready([next](const U& result) mutable {
+        next.set_value(result);
+      });
+    }
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+#endif  // INCLUDE_CLIENT_KVS_FUTURE_HPP_
@@ -0,0 +1,269 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_CLIENT_KVS_THREADED_CLIENT_HPP_
+#define INCLUDE_CLIENT_KVS_THREADED_CLIENT_HPP_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+#include "client/kvs_client.hpp"
+#include "mpsc_queue.hpp"
+
+// A request handed from an application thread to the I/O thread.
+struct KvsCommand {
+  RequestType type_;
+  Key key_;
+  string payload_;
+  LatticeType lattice_type_;
+  ResponseCallback callback_;
+};
+
+// A KvsThreadedClient lets any number of application threads share a single
+// KvsClient, and with it one ZMQ context, one set of bound ports and one key
+// address cache. Requests are pushed onto a lock-free queue and issued by a
+// dedicated I/O thread, which is the only thread that touches the sockets.
+// Completion is reported through a std::future or a callback; callbacks run on
+// the I/O thread, so they should be short and must not wait on futures
+// returned by the same client.
+//
+// The I/O thread sleeps in KvsClient::receive until a response arrives, a
+// pending request reaches its deadline, or a producer writes to a self-pipe
+// whose read end is part of the poll set. Only the first push after the I/O
+// thread has drained the queue writes to the pipe, so a burst of requests
+// costs one system call.
+//
+// Requests that are still outstanding when the client is destroyed are
+// dropped: their callbacks never run and their futures report a broken
+// promise.
+class KvsThreadedClient {
+ public:
+  /**
+   * @routing_threads A vector of routing addresses.
+   * @ip My node's IP address
+   * @tid The thread ID used to pick the I/O thread's ports
+   * @timeout Length of request timeouts in ms
+   * @poll_interval The longest time in ms that an idle I/O thread sleeps;
+   * submitted requests wake it up immediately
+   */
+  KvsThreadedClient(vector<UserRoutingThread> routing_threads, string ip,
+                    unsigned tid = 0, unsigned timeout = 10000,
+                    unsigned poll_interval = 1000) :
+      running_(true),
+      wakeup_pending_(false),
+      poll_interval_(poll_interval) {
+    open_wakeup_pipe();
+
+    std::promise<void> started;
+    std::future<void> start_result = started.get_future();
+
+    io_thread_ = std::thread(&KvsThreadedClient::run, this, routing_threads,
+                             ip, tid, timeout, std::move(started));
+
+    // rethrow any error raised while creating the client (e.g., a port that
+    // is already bound)
+    try {
+      start_result.get();
+    } catch (...) {
+      io_thread_.join();
+      close_wakeup_pipe();
+      throw;
+    }
+  }
+
+  ~KvsThreadedClient() {
+    running_.store(false, std::memory_order_release);
+    wake_up();
+    io_thread_.join();
+    close_wakeup_pipe();
+  }
+
+  KvsThreadedClient(const KvsThreadedClient&) = delete;
+  KvsThreadedClient& operator=(const KvsThreadedClient&) = delete;
+
+  /**
+   * Issue a GET request; the future is fulfilled with the response.
+   */
+  std::future<KeyResponse> get(const Key& key) {
+    auto promise = std::make_shared<std::promise<KeyResponse>>();
+    std::future<KeyResponse> future = promise->get_future();
+
+    get(key, [promise](const KeyResponse& response) {
+      promise->set_value(response);
+    });
+    return future;
+  }
+
+  /**
+   * Issue a GET request; callback runs on the I/O thread with the response.
+   */
+  void get(const Key& key, ResponseCallback callback) {
+    submit(KvsCommand{RequestType::GET, key, "", LatticeType::NONE,
+                      std::move(callback)});
+  }
+
+  /**
+   * Issue a PUT request; the future is fulfilled with the response.
+   */
+  std::future<KeyResponse> put(const Key& key, string payload,
+                               LatticeType lattice_type) {
+    auto promise = std::make_shared<std::promise<KeyResponse>>();
+    std::future<KeyResponse> future = promise->get_future();
+
+    put(key, std::move(payload), lattice_type,
+        [promise](const KeyResponse& response) {
+          promise->set_value(response);
+        });
+    return future;
+  }
+
+  /**
+   * Issue a PUT request; callback runs on the I/O thread with the response.
+   */
+  void put(const Key& key, string payload, LatticeType lattice_type,
+           ResponseCallback callback) {
+    submit(KvsCommand{RequestType::PUT, key, std::move(payload),
+                      lattice_type, std::move(callback)});
+  }
+
+ private:
+  void submit(KvsCommand command) {
+    commands_.push(std::move(command));
+
+    // the push is visible before the flag is read, so either this call wakes
+    // the I/O thread or the one that set the flag did and the I/O thread has
+    // not yet drained the queue
+    if (!wakeup_pending_.exchange(true, std::memory_order_acq_rel)) {
+      wake_up();
+    }
+  }
+
+  /**
+   * Creates the self-pipe used to wake the I/O thread. Both ends are
+   * non-blocking, so a full pipe never stalls a producer and an empty one
+   * never stalls the I/O thread. This is a pipe rather than an eventfd so
+   * that the client also builds on macOS.
+   */
+  void open_wakeup_pipe() {
+    int fds[2];
+    if (pipe(fds) < 0) {
+      throw std::system_error(errno, std::generic_category(), "pipe");
+    }
+
+    for (int fd : fds) {
+      if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 ||
+          fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+        int error = errno;
+        close(fds[0]);
+        close(fds[1]);
+        throw std::system_error(error, std::generic_category(), "fcntl");
+      }
+    }
+
+    wakeup_read_fd_ = fds[0];
+    wakeup_write_fd_ = fds[1];
+  }
+
+  void close_wakeup_pipe() {
+    close(wakeup_read_fd_);
+    close(wakeup_write_fd_);
+  }
+
+  void wake_up() {
+    char byte = 0;
+    ssize_t written = write(wakeup_write_fd_, &byte, sizeof(byte));
+    (void)written;  // fails only if the pipe is full, i.e., readable
+  }
+
+  void drain_wakeups() {
+    char buffer[64];
+    // fails with EAGAIN once the pipe is empty
+    while (read(wakeup_read_fd_, buffer, sizeof(buffer)) > 0) {
+    }
+  }
+
+  /**
+   * The body of the I/O thread: it alternates between issuing queued
+   * requests and handing received responses to their callbacks.
+   */
+  void run(vector<UserRoutingThread> routing_threads, string ip, unsigned tid,
+           unsigned timeout, std::promise<void> started) {
+    std::unique_ptr<KvsClient> client;
+
+    try {
+      client.reset(new KvsClient(routing_threads, ip, tid, timeout));
+    } catch (...) {
+      started.set_exception(std::current_exception());
+      return;
+    }
+
+    client->add_wakeup_fd(wakeup_read_fd_);
+    started.set_value();
+
+    while (running_.load(std::memory_order_acquire)) {
+      // clear the flag before draining so that any later push signals again;
+      // an exchange, so that it also acquires every push that saw the flag set
+      wakeup_pending_.exchange(false, std::memory_order_acq_rel);
+
+      KvsCommand command;
+      while (commands_.pop(&command)) {
+        issue(*client, command);
+      }
+
+      // every request carries a callback, so responses are all handed out
+      // from within receive
+      client->receive(std::chrono::milliseconds(poll_interval_));
+      drain_wakeups();
+    }
+  }
+
+  void issue(KvsClient& client, KvsCommand& command) {
+    if (command.type_ == RequestType::GET) {
+      client.get_async(command.key_, std::move(command.callback_));
+    } else {
+      client.put_async(command.key_, command.payload_, command.lattice_type_,
+                       std::move(command.callback_));
+    }
+  }
+
+  // requests submitted by application threads
+  MpscQueue<KvsCommand> commands_;
+
+  // cleared to stop the I/O thread
+  std::atomic<bool> running_;
+
+  // set by the push that signals the wakeup pipe, cleared by the I/O thread
+  // before it drains commands_
+  std::atomic<bool> wakeup_pending_;
+
+  // the read end of the wakeup pipe is in the I/O thread's poll set; a byte
+  // is written to the other end when a request is submitted or the client is
+  // destroyed
+  int wakeup_read_fd_;
+  int wakeup_write_fd_;
+
+  // the longest time the I/O thread blocks in receive, in ms
+  unsigned poll_interval_;
+
+  std::thread io_thread_;
+};
+
+#endif  // INCLUDE_CLIENT_KVS_THREADED_CLIENT_HPP_
@@ -16,9 +16,13 @@
 #define INCLUDE_COMMON_HPP_
 
 #include <algorithm>
+#include <cstdlib>
+#include <functional>
 #include <sstream>
 
 #include "anna.pb.h"
+#include "lattices/delta_tracker.hpp"
+#include "lattices/flat_vector_clock.hpp"
 #include "lattices/lww_pair_lattice.hpp"
 #include "lattices/multi_key_causal_lattice.hpp"
 #include "lattices/priority_lattice.hpp"
@@ -33,7 +37,55 @@ const string kMetadataIdentifier = "ANNA_METADATA";
 const string kMetadataDelimiter = "|";
 const char kMetadataDelimiterChar = '|';
 const string kMetadataTypeCacheIP = "cache_ip";
-const unsigned kMaxSocketNumber = 10000;
+
+// The default number of messages a client handles in one receive call.
+const unsigned kDefaultReceiveBudget = 1000;
+
+// The most keys a client looks up in a single KeyAddressRequest.
+const unsigned kMaxKeyAddressBatch = 1000;
+
+// The first byte of a compactly serialized set. No serialized SetValue starts
+// with it, since protobuf field numbers start at 1 and an empty SetValue
+// serializes to nothing, so the set deserializers accept either format.
+const char kCompactSetMarker = '\0';
+
+// The number of strings per front-coded block of a compact set.
+const unsigned kCompactSetBlockSize = 16;
+
+// Invoked by a client with the response to an asynchronous request.
+using ResponseCallback = std::function<void(const KeyResponse&)>;
+
+// Request IDs carry the issuing client's ID in their high 32 bits and a
+// per-client sequence number in their low 32 bits, so they only repeat after
+// 2^32 requests from the same client.
+inline uint32_t get_client_id(const string& ip, unsigned tid) {
+  return static_cast<uint32_t>(std::hash<string>{}(ip) * 31 + tid);
+}
+
+inline RequestId make_request_id(uint32_t client_id, uint32_t seq) {
+  return (static_cast<RequestId>(client_id) << 32) | seq;
+}
+
+// The clients also send each request ID in decimal in the legacy string
+// request_id field, for storage and routing servers that do not echo
+// request_rid yet.
+inline string legacy_request_id(RequestId request_id) {
+  return std::to_string(request_id);
+}
+
+// Fills in whichever of response_rid and response_id a server did not echo,
+// so that responses can be matched on response_rid and callers can keep
+// comparing response_id with the ID a PUT returned.
+template <typename RES>
+void restore_response_ids(RES* response) {
+  if (response->response_rid() == 0 && !response->response_id().empty()) {
+    response->set_response_rid(
+        std::strtoull(response->response_id().c_str(), nullptr, 10));
+  } else if (response->response_rid() != 0 &&
+             response->response_id().empty()) {
+    response->set_response_id(legacy_request_id(response->response_rid()));
+  }
+}
 
 inline void split(const string& s, char delim, vector<string>& elems) {
   std::stringstream ss(s);
@@ -134,6 +186,179 @@ inline string serialize(const OrderedSetLattice<string>& l) {
   return serialized;
 }
 
+inline void append_varint(string* out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+// Reads a varint at *pos and advances past it. Returns false if the varint is
+// malformed or runs past end.
+inline bool read_varint(const char** pos, const char* end, uint64_t* value) {
+  *value = 0;
+
+  for (unsigned shift = 0; shift < 64 && *pos < end; shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(*(*pos)++);
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+    if (byte < 0x80) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Serializes the strings in [begin, end), which must be sorted, in the compact
+// set format: the marker, the string count, and then the strings in blocks of
+// kCompactSetBlockSize. Each block is prefixed with its length in bytes. The
+// first string of a block is stored whole and every other one as the length
+// of the prefix it shares with the one before it plus the rest of its bytes,
+// so sorted strings with common prefixes take little space.
+template <typename It>
+string serialize_compact_set(It begin, It end, size_t count) {
+  string serialized(1, kCompactSetMarker);
+  append_varint(&serialized, count);
+
+  string block;
+  const string* prev = nullptr;
+  unsigned in_block = 0;
+
+  for (It it = begin; it != end; ++it) {
+    const string& val = *it;
+    size_t shared = 0;
+
+    if (in_block > 0) {
+      size_t limit = std::min(prev->size(), val.size());
+      while (shared < limit && (*prev)[shared] == val[shared]) {
+        shared++;
+      }
+      append_varint(&block, shared);
+    }
+
+    append_varint(&block, val.size() - shared);
+    block.append(val, shared, string::npos);
+    prev = &val;
+
+    if (++in_block == kCompactSetBlockSize) {
+      append_varint(&serialized, block.size());
+      serialized += block;
+      block.clear();
+      in_block = 0;
+    }
+  }
+
+  if (in_block > 0) {
+    append_varint(&serialized, block.size());
+    serialized += block;
+  }
+
+  return serialized;
+}
+
+/**
+ * Decodes a set serialized by serialize_compact_set, inserting every string
+ * straight into result as it is decoded. The strings arrive sorted, so each is
+ * inserted with a hint at the end of result. Returns false if serialized is
+ * malformed, in which case the contents of result are unspecified.
+ */
+template <typename S>
+bool deserialize_compact_set(const string& serialized, S* result) {
+  const char* pos = serialized.data();
+  const char* end = pos + serialized.size();
+  uint64_t count;
+
+  if (pos == end || *pos++ != kCompactSetMarker ||
+      !read_varint(&pos, end, &count)) {
+    return false;
+  }
+
+  string val;
+  while (count > 0) {
+    uint64_t block_size;
+    if (!read_varint(&pos, end, &block_size) ||
+        block_size > static_cast<uint64_t>(end - pos)) {
+      return false;
+    }
+
+    const char* block_end = pos + block_size;
+    for (unsigned i = 0; i < kCompactSetBlockSize && count > 0; i++, count--) {
+      uint64_t shared = 0, suffix;
+
+      if ((i > 0 && !read_varint(&pos, block_end, &shared)) ||
+          !read_varint(&pos, block_end, &suffix) || shared > val.size() ||
+          suffix > static_cast<uint64_t>(block_end - pos)) {
+        return false;
+      }
+
+      val.resize(shared);
+      val.append(pos, suffix);
+      pos += suffix;
+      result->insert(result->end(), val);
+    }
+
+    if (pos != block_end) {
+      return false;
+    }
+  }
+
+  return pos == end;
+}
+
+/**
+ * Serializes l in the compact set format, which is much smaller than a
+ * SetValue for sets of strings that share prefixes. Only send it to readers
+ * that use this version of deserialize_set.
+ */
+inline string serialize_compact(const OrderedSetLattice<string>& l) {
+  return serialize_compact_set(l.reveal().begin(), l.reveal().end(),
+                               l.reveal().size());
+}
+
+inline string serialize_compact(const SetLattice<string>& l) {
+  // front coding needs the strings in order, so sort pointers to them
+  vector<const string*> sorted;
+  sorted.reserve(l.reveal().size());
+  for (const string& val : l.reveal()) {
+    sorted.push_back(&val);
+  }
+
+  std::sort(sorted.begin(), sorted.end(),
+            [](const string* a, const string* b) { return *a < *b; });
+
+  struct Deref {
+    vector<const string*>::const_iterator it;
+
+    const string& operator*() const { return **it; }
+    Deref& operator++() {
+      ++it;
+      return *this;
+    }
+    bool operator!=(const Deref& other) const { return it != other.it; }
+  };
+
+  return serialize_compact_set(Deref{sorted.cbegin()}, Deref{sorted.cend()},
+                               sorted.size());
+}
+
+/**
+ * Serializes the delta tracker has recorded since its last flush and starts a
+ * new one. If the PUT carrying the delta fails, hand the delta back with
+ * DeltaTracker::restore so it is sent again. Deltas are only defined for the
+ * set lattices, which are the only ones merge_delta can apply; other lattice
+ * types have to be written whole.
+ */
+inline string serialize_delta(DeltaTracker<SetLattice<string>>* tracker) {
+  return serialize(tracker->flush());
+}
+
+inline string serialize_delta(
+    DeltaTracker<OrderedSetLattice<string>>* tracker) {
+  return serialize(tracker->flush());
+}
+
 inline string serialize(const set<string>& set) {
   SetValue set_value;
   for (const string& val : set) {
@@ -226,28 +451,68 @@ inline LWWPairLattice<string> deserialize_lww(const string& serialized) {
       TimestampValuePair<string>(lww.timestamp(), lww.value()));
 }
 
+// A set that fails to decode is dropped whole rather than merged in part.
+inline void log_malformed_compact_set(const string& serialized) {
+  spdlog::error("Dropping a malformed compact set payload of {} bytes.",
+                serialized.size());
+}
+
+// Both set deserializers accept a SetValue as well as the compact format; a
+// malformed compact payload is logged and decodes to the empty set.
 inline SetLattice<string> deserialize_set(const string& serialized) {
+  set<string> result;
+
+  if (!serialized.empty() && serialized[0] == kCompactSetMarker) {
+    if (!deserialize_compact_set(serialized, &result)) {
+      log_malformed_compact_set(serialized);
+      return SetLattice<string>();
+    }
+
+    return SetLattice<string>(std::move(result));
+  }
+
   SetValue s;
   s.ParseFromString(serialized);
-
-  set<string> result;
+  result.reserve(s.values_size());
 
   for (const string& value : s.values()) {
     result.insert(value);
   }
 
-  return SetLattice<string>(result);
+  return SetLattice<string>(std::move(result));
 }
 
 inline OrderedSetLattice<string> deserialize_ordered_set(
     const string& serialized) {
+  ordered_set<string> result;
+
+  if (!serialized.empty() && serialized[0] == kCompactSetMarker) {
+    if (!deserialize_compact_set(serialized, &result)) {
+      log_malformed_compact_set(serialized);
+      return OrderedSetLattice<string>();
+    }
+
+    return OrderedSetLattice<string>(std::move(result));
+  }
+
   SetValue s;
   s.ParseFromString(serialized);
-  ordered_set<string> result;
   for (const string& value : s.values()) {
     result.insert(value);
   }
-  return OrderedSetLattice<string>(result);
+  return OrderedSetLattice<string>(std::move(result));
+}
+
+// Merges a received delta payload into state. Deltas are ordinary lattice
+// values, so this is a plain merge; the decoded elements are moved in. As
+// with serialize_delta, only the set lattices have deltas.
+inline void merge_delta(SetLattice<string>* state, const string& payload) {
+  state->merge(deserialize_set(payload));
+}
+
+inline void merge_delta(OrderedSetLattice<string>* state,
+                        const string& payload) {
+  state->merge(deserialize_ordered_set(payload));
 }
 
 inline SingleKeyCausalValue deserialize_causal(const string& serialized) {
@@ -326,6 +591,39 @@ inline SnapshotIsolationPayload<string> to_snapshot_isolation_payload(
     return p;
 }
 
+inline FlatVectorClock to_flat_vector_clock(
+    const google::protobuf::Map<string, uint32_t>& proto_clock) {
+  ClockEntries entries;
+  vector<pair<NodeId, unsigned>> sorted;
+  sorted.reserve(proto_clock.size());
+
+  NodeIdTable& table = NodeIdTable::get();
+  for (const auto& pair : proto_clock) {
+    sorted.push_back(std::make_pair(table.intern(pair.first), pair.second));
+  }
+  std::sort(sorted.begin(), sorted.end());
+
+  for (const auto& pair : sorted) {
+    entries.ids.push_back(pair.first);
+    entries.counters.push_back(pair.second);
+  }
+
+  FlatVectorClock vc;
+  vc.assign(std::move(entries));
+  return vc;
+}
+
+inline void to_proto_vector_clock(
+    const FlatVectorClock& vc,
+    google::protobuf::Map<string, uint32_t>* proto_clock) {
+  NodeIdTable& table = NodeIdTable::get();
+  const ClockEntries& entries = vc.reveal();
+
+  for (size_t i = 0; i < entries.ids.size(); i++) {
+    (*proto_clock)[table.name(entries.ids[i])] = entries.counters[i];
+  }
+}
+
 struct lattice_type_hash {
   std::size_t operator()(const LatticeType& lt) const {
     return std::hash<string>()(LatticeType_Name(lt));
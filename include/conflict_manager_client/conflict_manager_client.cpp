@@ -3,43 +3,44 @@
 //
 
 #include "conflict_manager_client.h"
+#include "deadline_queue.hpp"
 
-using TimePoint = std::chrono::time_point<std::chrono::system_clock>;
+#include <deque>
 
 struct PendingRequests {
     PendingRequests() = default;
-    PendingRequests(set<Key> read_set, TimePoint tp, KeyRequest request) :
+    PendingRequests(set<Key> read_set, KeyRequest request) :
         read_set_(read_set),
-        tp_(tp),
         request_(request){
         response_.set_type(request.type());
+        response_.set_response_id(request.request_id());
+        response_.set_response_rid(request.request_rid());
     }
 
     KeyRequest request_;
     set<Key> read_set_;
     KeyResponse response_;
-    TimePoint tp_;
 };
 
 struct PendingCommitRequests {
     PendingCommitRequests() = default;
-    PendingCommitRequests(set<Key> read_set, TimePoint tp, CommitRequest request) :
+    PendingCommitRequests(set<Key> read_set, CommitRequest request) :
             read_set_(read_set),
-            tp_(tp),
             request_(request){
         response_.set_response_id(request.request_id());
+        response_.set_response_rid(request.request_rid());
     }
 
     CommitRequest request_;
     set<Key> read_set_;
     CommitResponse response_;
-    TimePoint tp_;
 };
 
 class ConflictManagerClient : public ConflictManagerClientInterface {
 public:
     ConflictManagerClient(vector<ConflictManagerThread> conflict_manager_threads,
-                          string ip, unsigned tid = 0, unsigned timeout = 10000) :
+                          string ip, unsigned tid = 0, unsigned timeout = 10000,
+                          bool expire_pending = false) :
       context_(zmq::context_t(1)),
       conflict_manager_threads_(conflict_manager_threads),
       cmct_(ConflictManagerClientThread(ip, tid)),
@@ -48,7 +49,8 @@ public:
       key_get_version_response_puller_(zmq::socket_t(context_, ZMQ_PULL)),
       commit_response_puller_(zmq::socket_t(context_, ZMQ_PULL)),
       log_(spdlog::basic_logger_mt("cm_client_log", "cm_client_log.txt", true)),
-      timeout_(timeout)
+      timeout_(timeout),
+      expire_pending_(expire_pending)
     {
         log_->flush_on(spdlog::level::info);
 
@@ -63,14 +65,23 @@ public:
         key_get_version_response_puller_.bind(cmct_.key_get_version_response_bind_address());
         commit_response_puller_.bind(cmct_.commit_response_bind_address());
 
-        pollitems_ = {
+        // Key and commit responses are polled separately so that a blocking
+        // receive for one kind is not woken up by the other
+        key_pollitems_ = {
                 {static_cast<void*>(key_get_response_puller_), 0, ZMQ_POLLIN, 0},
                 {static_cast<void*>(key_get_version_response_puller_), 0, ZMQ_POLLIN, 0},
+        };
+        commit_pollitems_ = {
                 {static_cast<void*>(commit_response_puller_), 0, ZMQ_POLLIN, 0},
         };
 
+        client_id_ = get_client_id(ip, tid);
+
         // set the request ID to 0
         rid_ = 0;
+
+        receive_budget_ = kDefaultReceiveBudget;
+        received_count_ = 0;
     }
 
     ~ConflictManagerClient() {}
@@ -79,130 +90,54 @@ public:
 
     vector<KeyResponse> receive_async() {
         vector<KeyResponse> result;
-        kZmqUtil->poll(0, &pollitems_);
-        if (pollitems_[0].revents & ZMQ_POLLIN) {
-            string serialized = kZmqUtil->recv_string(&key_get_response_puller_);
-            KeyResponse response;
-            response.ParseFromString(serialized);
-
-            if (pending_requests_.find(response.response_id()) != pending_requests_.end()){
-                PendingRequests pending = pending_requests_[response.response_id()];
-
-                for (const auto &tuple : response.tuples()) {
-                    Key key = tuple.key();
-                    pending.read_set_.erase(key);
-                    auto tup = pending.response_.add_tuples();
-                    tup->set_key(key);
-                    tup->set_lattice_type(tuple.lattice_type());
-                    tup->set_payload(tuple.payload());
-                    tup->set_error(tuple.error());
-                }
-
-                if (pending.read_set_.empty()){
-                    result.push_back(pending.response_);
-                    pending_requests_.erase(response.response_id());
-                }
-            } else {
-                log_->error("Request does not exist");
-            }
-        }
+        received_count_ = receive_ready(result);
+        expire_requests(result);
+        return dispatch_callbacks(result);
+    }
 
-        if (pollitems_[1].revents & ZMQ_POLLIN) {
-            string serialized = kZmqUtil->recv_string(&key_get_version_response_puller_);
-            KeyResponse response;
-            response.ParseFromString(serialized);
-
-            if (pending_requests_.find(response.response_id()) != pending_requests_.end()){
-                auto &pending = pending_requests_[response.response_id()];
-
-                for (const auto &tuple : response.tuples()) {
-                    Key key = tuple.key();
-                    pending.read_set_.erase(key);
-                    auto tup = pending.response_.add_tuples();
-                    tup->set_key(key);
-                    tup->set_payload(tuple.payload());
-                    tup->set_error(tuple.error());
-                }
-
-                if (pending.read_set_.empty()){
-                    result.push_back(pending.response_);
-                    pending_requests_.erase(response.response_id());
-                }
-            } else {
-                log_->error("Request does not exist");
-            }
-        }
+    // Blocking version of receive_async: waits up to max_wait for a key response
+    // or for the earliest pending request to time out, then handles everything
+    // that is ready
+    vector<KeyResponse> receive(std::chrono::milliseconds max_wait) {
+        vector<KeyResponse> result;
+        long timeout = request_timer_.cap_wait(SteadyClock::now(), max_wait).count();
+        received_count_ = 0;
 
-        /*
-        // GC the pending request map
-        set<string> to_remove;
-        for (const auto& pair : pending_requests_) {
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(
-                    std::chrono::system_clock::now() - pair.second.tp_)
-                        .count() > timeout_) {
-                // query to the routing tier timed out
-                result.push_back(generate_bad_response(pair.second.request_));
-
-                to_remove.insert(pair.first);
-            }
+        if (kZmqUtil->poll(timeout, &key_pollitems_) > 0) {
+            received_count_ = receive_ready(result);
         }
 
-        for (const auto& request : to_remove) {
-            pending_requests_.erase(request);
-        }
-         */
-        return result;
+        expire_requests(result);
+        return dispatch_callbacks(result);
     }
 
     vector<CommitResponse> receive_commit_async(){
         vector<CommitResponse> result;
-        kZmqUtil->poll(0, &pollitems_);
-        if (pollitems_[2].revents & ZMQ_POLLIN) {
-            string serialized = kZmqUtil->recv_string(&commit_response_puller_);
-            CommitResponse response;
-            response.ParseFromString(serialized);
-
-            if (pending_commit_requests_.find(response.response_id()) != pending_commit_requests_.end()){
-
-                auto &pending = pending_commit_requests_[response.response_id()];
-                if (response.abort_flag() != CommitError::C_NO_ERROR){
-                    pending.response_.set_abort_flag(response.abort_flag());
-                    result.push_back(pending.response_);
-                }
-                for (const auto &key : response.committed_keys()) {
-                    pending.read_set_.erase(key);
-                    pending.response_.set_commit_time(response.commit_time());
-                }
-
-                if (pending.read_set_.empty()){
-                    result.push_back(pending.response_);
-                    pending_commit_requests_.erase(response.response_id());
-                }
-            } else {
-                log_->error("Request does not exist");
-            }
-        }
+        received_count_ = receive_commit_ready(result);
+        expire_commits(result);
+        return dispatch_commit_callbacks(result);
+    }
 
-        // GC the pending request map
-        /*
-        set<string> to_remove;
-        for (const auto& pair : pending_commit_requests_) {
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(
-                    std::chrono::system_clock::now() - pair.second.tp_)
-                        .count() > timeout_) {
-                // query to the routing tier timed out
-                pending_commit_requests_[pair.first].response_.set_abort_flag(CommitError::C_TIMEOUT);
-                result.push_back(pending_commit_requests_[pair.first].response_);
-
-                to_remove.insert(pair.first);
-            }
-        }
-        for (const auto& request : to_remove) {
-            pending_commit_requests_.erase(request);
+    // Blocking version of receive_commit_async
+    vector<CommitResponse> receive_commit(std::chrono::milliseconds max_wait) {
+        vector<CommitResponse> result;
+        long timeout = commit_timer_.cap_wait(SteadyClock::now(), max_wait).count();
+        received_count_ = 0;
+
+        if (kZmqUtil->poll(timeout, &commit_pollitems_) > 0) {
+            received_count_ = receive_commit_ready(result);
         }
-         */
-        return result;
+
+        expire_commits(result);
+        return dispatch_commit_callbacks(result);
     }
+
+    // Set the maximum number of messages handled by one receive call
+    void set_receive_budget(unsigned budget) { receive_budget_ = budget; }
+
+    // Get the number of messages handled by the last receive call
+    unsigned get_received_count() { return received_count_; }
+
     zmq::context_t* get_context() { return &context_; }
 
     void get_key_async(const Key& key, uint64_t snapshot){
@@ -213,20 +148,14 @@ public:
     }
 
     void get_key_async(set<Key> keys, uint64_t snapshot){
-        KeyRequest request;
-        request.set_type(RequestType::GET);
-        request.set_response_address(cmct_.key_get_response_connect_address());
-        string request_id = get_request_id(snapshot);
-        request.set_request_id(request_id);
-        request.set_snapshot(snapshot);
+        issue_key_request(RequestType::GET, std::move(keys), snapshot);
+    }
 
-        for (auto const& key: keys){
-            KeyTuple* tuple = request.add_tuples();
-            tuple->set_key(key);
-        }
-        pending_requests_.emplace(request_id, PendingRequests(keys, std::chrono::system_clock::now(), request));
-        Address worker = get_key_worker_thread();
-        send_request<KeyRequest>(request, socket_cache_[worker]);
+    // The response is handed to callback instead of being returned from
+    // receive_async
+    void get_key_async(set<Key> keys, uint64_t snapshot, ResponseCallback callback){
+        RequestId request_id = issue_key_request(RequestType::GET, std::move(keys), snapshot);
+        key_callbacks_[request_id] = std::move(callback);
     }
 
     void get_key_version_async(const Key& key, uint64_t snapshot){
@@ -236,30 +165,72 @@ public:
     }
 
     void get_key_version_async(set<Key> keys, uint64_t snapshot){
+        issue_key_request(RequestType::GET_VERSION, std::move(keys), snapshot);
+    }
+
+    void commit_async(vector<Key> keys, vector<string> payloads, LatticeType type, uint64_t snapshot){
+        issue_commit(keys, payloads, type, snapshot);
+    }
+
+    // The response is handed to callback instead of being returned from
+    // receive_commit_async
+    void commit_async(vector<Key> keys, vector<string> payloads, LatticeType type,
+                      uint64_t snapshot, CommitCallback callback){
+        RequestId request_id = issue_commit(keys, payloads, type, snapshot);
+        commit_callbacks_[request_id] = std::move(callback);
+    }
+
+    // Get request id to correspond between
+    string get_request_id(uint64_t snapshot) {
+        return std::to_string(snapshot)+ "_" + cmct_.ip() + ":" + std::to_string(cmct_.tid());
+    }
+
+    // Get the compact id used to match responses to requests
+    RequestId get_request_rid() {
+        return make_request_id(client_id_, rid_++);
+    }
+
+private:
+    // Send a GET or GET_VERSION request for keys; returns its request id
+    RequestId issue_key_request(RequestType type, set<Key> keys, uint64_t snapshot){
         KeyRequest request;
-        request.set_type(RequestType::GET_VERSION);
-        request.set_response_address(cmct_.key_get_version_response_connect_address());
-        string request_id = get_request_id(snapshot);
-        request.set_request_id(request_id);
+        request.set_type(type);
+        if (type == RequestType::GET) {
+            request.set_response_address(cmct_.key_get_response_connect_address());
+        } else {
+            request.set_response_address(cmct_.key_get_version_response_connect_address());
+        }
+        request.set_request_id(get_request_id(snapshot));
+        RequestId request_id = get_request_rid();
+        request.set_request_rid(request_id);
         request.set_snapshot(snapshot);
 
         for (auto const& key: keys){
             KeyTuple* tuple = request.add_tuples();
             tuple->set_key(key);
         }
-        pending_requests_.emplace(request_id, PendingRequests(keys, std::chrono::system_clock::now(), request));
-        Address worker = get_key_version_worker_thread();
+        pending_requests_.emplace(request_id, PendingRequests(keys, request));
+        legacy_request_ids_[request.request_id()].push_back(request_id);
+        if (expire_pending_) {
+            request_timer_.schedule(request_id, get_deadline());
+        }
+        Address worker = type == RequestType::GET ? get_key_worker_thread()
+                                                  : get_key_version_worker_thread();
         send_request<KeyRequest>(request, socket_cache_[worker]);
-
+        return request_id;
     }
 
-    void commit_async(vector<Key> keys, vector<string> payloads, LatticeType type, uint64_t snapshot){
+    // Send a commit request for the write set; returns its request id
+    RequestId issue_commit(const vector<Key>& keys, const vector<string>& payloads,
+                           LatticeType type, uint64_t snapshot){
         // Make "PUT" request for the keys to be committed
         KeyRequest request;
         request.set_type(RequestType::PUT);
         request.set_snapshot(snapshot);
         string request_id = get_request_id(snapshot);
+        RequestId request_rid = get_request_rid();
         request.set_request_id(request_id);
+        request.set_request_rid(request_rid);
         set<Key> key_set;
         for (int key = 0; key < keys.size(); key++){
             auto tuple = request.add_tuples();
@@ -268,8 +239,6 @@ public:
             tuple->set_payload(payloads[key]);
             key_set.insert(keys[key]);
         }
-        string serialized_key_request;
-        request.SerializeToString(&serialized_key_request);
 
         // Make commit request
         CommitRequest commit_request;
@@ -278,18 +247,22 @@ public:
         commit_request.set_commit_type(CommitType::C_BEGIN);
         commit_request.set_coordinator_address(worker);
         commit_request.set_request_id(request_id);
-        commit_request.set_key_request(serialized_key_request);
+        commit_request.set_request_rid(request_rid);
+        // serialize the key request in place rather than through a temporary
+        request.SerializeToString(commit_request.mutable_key_request());
         Address response_address = cmct_.commit_response_connect_address();
         commit_request.set_client_address(response_address);
-        pending_commit_requests_.emplace(request_id, PendingCommitRequests(key_set, std::chrono::system_clock::now(), commit_request));
+        pending_commit_requests_.emplace(request_rid, PendingCommitRequests(key_set, commit_request));
+        legacy_commit_ids_[request_id].push_back(request_rid);
+        if (expire_pending_) {
+            commit_timer_.schedule(request_rid, get_deadline());
+        }
 
         send_request<CommitRequest>(commit_request, socket_cache_[worker]);
+        return request_rid;
     }
 
-    // Get request id to correspond between
-    string get_request_id(uint64_t snapshot) {
-        return std::to_string(snapshot)+ "_" + cmct_.ip() + ":" + std::to_string(cmct_.tid());
-    }
+public:
 
     // Get which thread to send the get key request
     string get_key_worker_thread(){
@@ -309,11 +282,17 @@ public:
         return conflict_manager_threads_[0].commit_connect_address();
     }
 
+    // Get the deadline for a request issued now
+    Deadline get_deadline() {
+        return SteadyClock::now() + std::chrono::milliseconds(timeout_);
+    }
+
     KeyResponse generate_bad_response(const KeyRequest& req) {
         KeyResponse resp;
 
         resp.set_type(req.type());
         resp.set_response_id(req.request_id());
+        resp.set_response_rid(req.request_rid());
         resp.set_error(AnnaError::TIMEOUT);
         resp.set_snapshot(req.snapshot());
 
@@ -330,8 +309,222 @@ public:
         return resp;
     }
 
-
 private:
+    // Drain both key response sockets without blocking until they are empty or
+    // receive_budget_ messages have been handled; returns the number handled
+    unsigned receive_ready(vector<KeyResponse>& result) {
+        unsigned count = 0;
+        bool drained = false;
+        zmq::message_t message;
+
+        while (!drained && count < receive_budget_) {
+            drained = true;
+
+            if (kZmqUtil->try_recv_message(&key_get_response_puller_, &message)) {
+                KeyResponse response;
+                parse_from_message(message, &response);
+                handle_get_response(response, result);
+                drained = false;
+                count++;
+            }
+
+            if (count < receive_budget_ &&
+                kZmqUtil->try_recv_message(&key_get_version_response_puller_, &message)) {
+                KeyResponse response;
+                parse_from_message(message, &response);
+                handle_get_version_response(response, result);
+                drained = false;
+                count++;
+            }
+        }
+
+        return count;
+    }
+
+    void handle_get_response(const KeyResponse& response, vector<KeyResponse>& result) {
+        RequestId rid = resolve_rid(response, legacy_request_ids_);
+        if (pending_requests_.find(rid) != pending_requests_.end()){
+            auto &pending = pending_requests_[rid];
+
+            for (const auto &tuple : response.tuples()) {
+                Key key = tuple.key();
+                pending.read_set_.erase(key);
+                auto tup = pending.response_.add_tuples();
+                tup->set_key(key);
+                tup->set_lattice_type(tuple.lattice_type());
+                tup->set_payload(tuple.payload());
+                tup->set_error(tuple.error());
+            }
+
+            if (pending.read_set_.empty()){
+                result.push_back(pending.response_);
+                forget_legacy_id(legacy_request_ids_, pending.request_.request_id(), rid);
+                pending_requests_.erase(rid);
+                request_timer_.cancel(rid);
+            }
+        } else {
+            log_->error("Request does not exist");
+        }
+    }
+
+    void handle_get_version_response(const KeyResponse& response, vector<KeyResponse>& result) {
+        RequestId rid = resolve_rid(response, legacy_request_ids_);
+        if (pending_requests_.find(rid) != pending_requests_.end()){
+            auto &pending = pending_requests_[rid];
+
+            for (const auto &tuple : response.tuples()) {
+                Key key = tuple.key();
+                pending.read_set_.erase(key);
+                auto tup = pending.response_.add_tuples();
+                tup->set_key(key);
+                tup->set_payload(tuple.payload());
+                tup->set_error(tuple.error());
+            }
+
+            if (pending.read_set_.empty()){
+                result.push_back(pending.response_);
+                forget_legacy_id(legacy_request_ids_, pending.request_.request_id(), rid);
+                pending_requests_.erase(rid);
+                request_timer_.cancel(rid);
+            }
+        } else {
+            log_->error("Request does not exist");
+        }
+    }
+
+    // Find the request a response answers. Conflict managers that predate
+    // request_rid leave response_rid unset and only echo the string request
+    // id, which every request of a transaction shares; such a response is
+    // matched to the oldest pending request with that id. Returns 0 if there
+    // is none.
+    template <typename RES>
+    RequestId resolve_rid(const RES& response, map<string, std::deque<RequestId>>& legacy_ids) {
+        if (response.response_rid() != 0) {
+            return response.response_rid();
+        }
+
+        auto it = legacy_ids.find(response.response_id());
+        return it == legacy_ids.end() ? 0 : it->second.front();
+    }
+
+    // Drop a finished request from the legacy id index
+    void forget_legacy_id(map<string, std::deque<RequestId>>& legacy_ids,
+                          const string& request_id, RequestId rid) {
+        auto it = legacy_ids.find(request_id);
+        if (it == legacy_ids.end()) {
+            return;
+        }
+
+        auto &rids = it->second;
+        rids.erase(std::remove(rids.begin(), rids.end(), rid), rids.end());
+        if (rids.empty()) {
+            legacy_ids.erase(it);
+        }
+    }
+
+    // GC the pending request map
+    void expire_requests(vector<KeyResponse>& result) {
+        for (const auto& request_id : request_timer_.expire(SteadyClock::now())) {
+            auto &pending = pending_requests_[request_id];
+            result.push_back(generate_bad_response(pending.request_));
+            forget_legacy_id(legacy_request_ids_, pending.request_.request_id(), request_id);
+            pending_requests_.erase(request_id);
+        }
+    }
+
+    // Hand each response that has callbacks waiting on it to those callbacks;
+    // returns the rest
+    vector<KeyResponse> dispatch_callbacks(const vector<KeyResponse>& responses) {
+        vector<KeyResponse> unclaimed;
+
+        for (const auto& response : responses) {
+            auto it = key_callbacks_.find(response.response_rid());
+            if (it == key_callbacks_.end()) {
+                unclaimed.push_back(response);
+                continue;
+            }
+
+            // the callback may issue new requests, so detach it first
+            ResponseCallback callback = std::move(it->second);
+            key_callbacks_.erase(it);
+            callback(response);
+        }
+
+        return unclaimed;
+    }
+
+    // Drain the commit response socket without blocking, handling at most
+    // receive_budget_ messages; returns the number handled
+    unsigned receive_commit_ready(vector<CommitResponse>& result) {
+        unsigned count = 0;
+        zmq::message_t message;
+
+        while (count < receive_budget_ &&
+               kZmqUtil->try_recv_message(&commit_response_puller_, &message)) {
+            CommitResponse response;
+            parse_from_message(message, &response);
+            handle_commit_response(response, result);
+            count++;
+        }
+
+        return count;
+    }
+
+    void handle_commit_response(const CommitResponse& response, vector<CommitResponse>& result) {
+        RequestId rid = resolve_rid(response, legacy_commit_ids_);
+        if (pending_commit_requests_.find(rid) != pending_commit_requests_.end()){
+
+            auto &pending = pending_commit_requests_[rid];
+            if (response.abort_flag() != CommitError::C_NO_ERROR){
+                pending.response_.set_abort_flag(response.abort_flag());
+                result.push_back(pending.response_);
+            }
+            for (const auto &key : response.committed_keys()) {
+                pending.read_set_.erase(key);
+                pending.response_.set_commit_time(response.commit_time());
+            }
+
+            if (pending.read_set_.empty()){
+                result.push_back(pending.response_);
+                forget_legacy_id(legacy_commit_ids_, pending.request_.request_id(), rid);
+                pending_commit_requests_.erase(rid);
+                commit_timer_.cancel(rid);
+            }
+        } else {
+            log_->error("Request does not exist");
+        }
+    }
+
+    // GC the pending commit request map
+    void expire_commits(vector<CommitResponse>& result) {
+        for (const auto& request_id : commit_timer_.expire(SteadyClock::now())) {
+            auto &pending = pending_commit_requests_[request_id];
+            pending.response_.set_abort_flag(CommitError::C_TIMEOUT);
+            result.push_back(pending.response_);
+            forget_legacy_id(legacy_commit_ids_, pending.request_.request_id(), request_id);
+            pending_commit_requests_.erase(request_id);
+        }
+    }
+
+    // Commit counterpart of dispatch_callbacks
+    vector<CommitResponse> dispatch_commit_callbacks(const vector<CommitResponse>& responses) {
+        vector<CommitResponse> unclaimed;
+
+        for (const auto& response : responses) {
+            auto it = commit_callbacks_.find(response.response_rid());
+            if (it == commit_callbacks_.end()) {
+                unclaimed.push_back(response);
+                continue;
+            }
+
+            CommitCallback callback = std::move(it->second);
+            commit_callbacks_.erase(it);
+            callback(response);
+        }
+
+        return unclaimed;
+    }
+
     // the ZMQ context we use to create sockets
     zmq::context_t context_;
 
@@ -345,7 +538,8 @@ private:
     zmq::socket_t key_get_version_response_puller_;
     zmq::socket_t commit_response_puller_;
 
-    vector<zmq::pollitem_t> pollitems_;
+    vector<zmq::pollitem_t> key_pollitems_;
+    vector<zmq::pollitem_t> commit_pollitems_;
 
     // the random seed for this client
     unsigned seed_;
@@ -356,13 +550,40 @@ private:
     // GC timeout
     unsigned timeout_;
 
+    // whether pending requests are failed and GCed after timeout_; off by
+    // default, as the conflict manager may take arbitrarily long to answer and
+    // a timed out commit could still be applied
+    bool expire_pending_;
+
+    // the maximum number of messages handled per receive call
+    unsigned receive_budget_;
+
+    // the number of messages handled by the last receive call
+    unsigned received_count_;
+
+    // the high half of this client's request ids
+    uint32_t client_id_;
+
     // the current request id
-    unsigned rid_;
+    uint32_t rid_;
 
     // cache for opened sockets
     SocketCache socket_cache_;
 
-    map<string, PendingRequests> pending_requests_;
-    map<string, PendingCommitRequests> pending_commit_requests_;
+    map<RequestId, PendingRequests> pending_requests_;
+    map<RequestId, PendingCommitRequests> pending_commit_requests_;
+
+    // the pending requests and commits by their string request id, oldest
+    // first, for responses that carry no response_rid
+    map<string, std::deque<RequestId>> legacy_request_ids_;
+    map<string, std::deque<RequestId>> legacy_commit_ids_;
+
+    // timeouts for the two pending maps above; empty unless expire_pending_
+    DeadlineQueue<RequestId> request_timer_;
+    DeadlineQueue<RequestId> commit_timer_;
+
+    // callbacks waiting on get_key and commit responses, by request ID
+    map<RequestId, ResponseCallback> key_callbacks_;
+    map<RequestId, CommitCallback> commit_callbacks_;
 
 };
\ No newline at end of file
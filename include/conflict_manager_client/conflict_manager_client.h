@@ -7,21 +7,54 @@
 
 
 #include "anna.pb.h"
+#include "client/kvs_future.hpp"
 #include "common.hpp"
 #include "requests.hpp"
 #include "threads.hpp"
 #include "types.hpp"
 #include "snapshot_isolation.pb.h"
+
+using CommitCallback = std::function<void(const CommitResponse&)>;
+
 class ConflictManagerClientInterface {
 public:
     virtual zmq::context_t* get_context() = 0;
     virtual vector<KeyResponse> receive_async() = 0;
+    virtual vector<KeyResponse> receive(std::chrono::milliseconds max_wait) = 0;
     virtual void get_key_async(const Key& key, uint64_t snapshot) = 0;
     virtual void get_key_async(set<Key> keys, uint64_t snapshot) = 0;
     virtual void get_key_version_async(const Key& key, uint64_t snapshot) = 0;
     virtual void get_key_version_async(set<Key> keys, uint64_t snapshot) = 0;
     virtual void commit_async(vector<Key> keys, vector<string> payloads, LatticeType type, uint64_t snapshot) = 0;
     virtual vector<CommitResponse> receive_commit_async() = 0;
+    virtual vector<CommitResponse> receive_commit(std::chrono::milliseconds max_wait) = 0;
+
+    // Variants of get_key_async and commit_async that hand the response to
+    // callback from within the receive call that completes the request,
+    // instead of returning it from that call
+    virtual void get_key_async(set<Key> keys, uint64_t snapshot, ResponseCallback callback) = 0;
+    virtual void commit_async(vector<Key> keys, vector<string> payloads, LatticeType type,
+                              uint64_t snapshot, CommitCallback callback) = 0;
+
+    // Read keys at snapshot and return a future for the response
+    KvsFuture<KeyResponse> get_key(set<Key> keys, uint64_t snapshot) {
+        KvsFuture<KeyResponse> future;
+        get_key_async(std::move(keys), snapshot, [future](const KeyResponse& response) mutable {
+            future.set_value(response);
+        });
+        return future;
+    }
+
+    // Commit a write set and return a future for the outcome
+    KvsFuture<CommitResponse> commit(vector<Key> keys, vector<string> payloads, LatticeType type,
+                                     uint64_t snapshot) {
+        KvsFuture<CommitResponse> future;
+        commit_async(std::move(keys), std::move(payloads), type, snapshot,
+                     [future](const CommitResponse& response) mutable {
+                         future.set_value(response);
+                     });
+        return future;
+    }
 };
 
 #endif //FAASSI_CONFLICT_MANAGER_CLIENT_H
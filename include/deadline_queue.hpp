@@ -0,0 +1,149 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_DEADLINE_QUEUE_HPP_
+#define INCLUDE_DEADLINE_QUEUE_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <queue>
+
+#include "types.hpp"
+
+using SteadyClock = std::chrono::steady_clock;
+using Deadline = SteadyClock::time_point;
+
+// A DeadlineQueue tracks at most one deadline per pending request ID so that
+// the clients can find expired requests without scanning all of their pending
+// maps. Deadlines live in a min-heap; rescheduling or cancelling an ID leaves
+// its old heap entry in place, and that stale entry is dropped lazily once it
+// reaches the top of the heap. Expiring requests therefore only touches the
+// entries whose deadlines have passed. An example:
+//
+//   DeadlineQueue<Key> timer;
+//   timer.schedule("a", SteadyClock::now() + std::chrono::seconds(1));
+//   timer.schedule("b", SteadyClock::now() + std::chrono::seconds(1));
+//   timer.cancel("b");
+//   // One second later, this returns {"a"}.
+//   vector<Key> expired = timer.expire(SteadyClock::now());
+template <typename ID, typename H = std::hash<ID>>
+class DeadlineQueue {
+ public:
+  // Sets the deadline for `id`, replacing any deadline it already had.
+  void schedule(const ID& id, const Deadline& deadline) {
+    deadlines_[id] = deadline;
+    heap_.push(Entry{deadline, id});
+  }
+
+  // Stops tracking `id`; this is a no-op if `id` has no deadline.
+  void cancel(const ID& id) { deadlines_.erase(id); }
+
+  bool contains(const ID& id) const {
+    return deadlines_.find(id) != deadlines_.end();
+  }
+
+  // Removes and returns every ID whose deadline is at or before `now`, in
+  // deadline order.
+  vector<ID> expire(const Deadline& now) {
+    vector<ID> expired;
+
+    while (!heap_.empty() && heap_.top().deadline <= now) {
+      Entry entry = heap_.top();
+      heap_.pop();
+
+      auto it = deadlines_.find(entry.id);
+      if (it != deadlines_.end() && it->second == entry.deadline) {
+        deadlines_.erase(it);
+        expired.push_back(std::move(entry.id));
+      }
+    }
+
+    return expired;
+  }
+
+  // Returns false if nothing is scheduled; otherwise, sets `next` to the
+  // earliest outstanding deadline.
+  bool next_deadline(Deadline* next) {
+    prune();
+
+    if (heap_.empty()) {
+      return false;
+    }
+
+    *next = heap_.top().deadline;
+    return true;
+  }
+
+  // Shortens max_wait so that a wait starting at `now` ends no later than the
+  // earliest outstanding deadline. The result is rounded up to whole
+  // milliseconds so that pollers do not wake up just before the deadline.
+  std::chrono::milliseconds cap_wait(const Deadline& now,
+                                     std::chrono::milliseconds max_wait) {
+    Deadline next;
+    if (!next_deadline(&next)) {
+      return max_wait;
+    }
+
+    if (next <= now) {
+      return std::chrono::milliseconds(0);
+    }
+
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        next - now + std::chrono::milliseconds(1) - SteadyClock::duration(1));
+    return std::min(max_wait, remaining);
+  }
+
+  unsigned size() const { return deadlines_.size(); }
+
+  bool empty() const { return deadlines_.empty(); }
+
+  void clear() {
+    deadlines_.clear();
+    heap_ = Heap();
+  }
+
+ private:
+  struct Entry {
+    Deadline deadline;
+    ID id;
+  };
+
+  struct LaterDeadline {
+    bool operator()(const Entry& lhs, const Entry& rhs) const {
+      return lhs.deadline > rhs.deadline;
+    }
+  };
+
+  using Heap = std::priority_queue<Entry, vector<Entry>, LaterDeadline>;
+
+  // Drops cancelled and rescheduled entries from the top of the heap.
+  void prune() {
+    while (!heap_.empty()) {
+      auto it = deadlines_.find(heap_.top().id);
+      if (it != deadlines_.end() && it->second == heap_.top().deadline) {
+        return;
+      }
+
+      heap_.pop();
+    }
+  }
+
+  Heap heap_;
+
+  // the live deadline of every tracked ID
+  hmap<ID, Deadline, H> deadlines_;
+};
+
+#endif  // INCLUDE_DEADLINE_QUEUE_HPP_
@@ -0,0 +1,405 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_FLAT_HASH_MAP_HPP_
+#define INCLUDE_FLAT_HASH_MAP_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A FlatHashMap is an open-addressing hash map with the subset of the
+// std::unordered_map interface that the clients use. Entries live in a single
+// array and are found by linear probing, guided by a parallel array of one
+// byte control words: a control word says whether its slot is empty, erased,
+// or full, and in the last case also holds 7 bits of the entry's hash, so
+// most probes that do not match are rejected without touching the entry.
+//
+// Unlike std::unordered_map, inserting into a FlatHashMap may move its
+// entries, which invalidates all iterators, pointers and references into the
+// map. Erasing only invalidates iterators to the erased entry. Entries are
+// exposed as std::pair<K, V>; the key must not be modified through them.
+template <typename K, typename V, typename H = std::hash<K>,
+          typename E = std::equal_to<K>>
+class FlatHashMap {
+ public:
+  using key_type = K;
+  using mapped_type = V;
+  using value_type = std::pair<K, V>;
+  using size_type = std::size_t;
+
+  template <bool Const>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = FlatHashMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference =
+        typename std::conditional<Const, const value_type&, value_type&>::type;
+    using pointer =
+        typename std::conditional<Const, const value_type*, value_type*>::type;
+    using Map =
+        typename std::conditional<Const, const FlatHashMap, FlatHashMap>::type;
+
+    Iterator() : map_(nullptr), index_(0) {}
+
+    Iterator(Map* map, size_type index) : map_(map), index_(index) {
+      skip_free();
+    }
+
+    // iterators convert to const_iterators
+    template <bool C = Const, typename = typename std::enable_if<C>::type>
+    Iterator(const Iterator<false>& other) :
+        map_(other.map()),
+        index_(other.index()) {}
+
+    reference operator*() const { return map_->slots_[index_]; }
+    pointer operator->() const { return &map_->slots_[index_]; }
+
+    Iterator& operator++() {
+      index_++;
+      skip_free();
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return index_ == other.index_;
+    }
+
+    bool operator!=(const Iterator& other) const {
+      return index_ != other.index_;
+    }
+
+    Map* map() const { return map_; }
+    size_type index() const { return index_; }
+
+   private:
+    void skip_free() {
+      while (index_ < map_->capacity_ && !is_full(map_->ctrl_[index_])) {
+        index_++;
+      }
+    }
+
+    Map* map_;
+    size_type index_;
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  FlatHashMap() : slots_(nullptr), capacity_(0), size_(0), erased_(0) {}
+
+  FlatHashMap(const FlatHashMap& other) : FlatHashMap() {
+    reserve(other.size_);
+    for (const value_type& entry : other) {
+      emplace_unique(entry.first, entry.second);
+    }
+  }
+
+  FlatHashMap(FlatHashMap&& other) noexcept : FlatHashMap() { swap(other); }
+
+  FlatHashMap& operator=(const FlatHashMap& other) {
+    if (this != &other) {
+      FlatHashMap copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  FlatHashMap& operator=(FlatHashMap&& other) noexcept {
+    FlatHashMap moved(std::move(other));
+    swap(moved);
+    return *this;
+  }
+
+  ~FlatHashMap() {
+    destroy_all();
+    deallocate(slots_, capacity_);
+  }
+
+  void swap(FlatHashMap& other) noexcept {
+    std::swap(ctrl_, other.ctrl_);
+    std::swap(slots_, other.slots_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(size_, other.size_);
+    std::swap(erased_, other.erased_);
+    std::swap(hasher_, other.hasher_);
+    std::swap(equal_, other.equal_);
+  }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, capacity_); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, capacity_); }
+
+  size_type size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator find(const K& key) {
+    return iterator(this, find_index(key, hash(key)));
+  }
+
+  const_iterator find(const K& key) const {
+    return const_iterator(this, find_index(key, hash(key)));
+  }
+
+  size_type count(const K& key) const {
+    return find_index(key, hash(key)) == capacity_ ? 0 : 1;
+  }
+
+  V& operator[](const K& key) { return try_emplace(key).first->second; }
+  V& operator[](K&& key) { return try_emplace(std::move(key)).first->second; }
+
+  // Inserts an entry for key, constructed from args, unless key is already
+  // present.
+  template <typename KK, typename... Args>
+  std::pair<iterator, bool> try_emplace(KK&& key, Args&&... args) {
+    std::size_t h = hash(key);
+    size_type index = find_index(key, h);
+    if (index != capacity_) {
+      return std::make_pair(iterator(this, index), false);
+    }
+
+    index = insert_index(h);
+    new (&slots_[index]) value_type(
+        std::piecewise_construct, std::forward_as_tuple(std::forward<KK>(key)),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+    ctrl_[index] = full_ctrl(h);
+    size_++;
+    return std::make_pair(iterator(this, index), true);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    value_type entry(std::forward<Args>(args)...);
+    return try_emplace(std::move(entry.first), std::move(entry.second));
+  }
+
+  std::pair<iterator, bool> insert(const value_type& entry) {
+    return try_emplace(entry.first, entry.second);
+  }
+
+  size_type erase(const K& key) {
+    size_type index = find_index(key, hash(key));
+    if (index == capacity_) {
+      return 0;
+    }
+
+    erase_index(index);
+    return 1;
+  }
+
+  iterator erase(const_iterator it) {
+    erase_index(it.index());
+    return iterator(this, it.index() + 1);
+  }
+
+  iterator erase(iterator it) { return erase(const_iterator(it)); }
+
+  void clear() {
+    destroy_all();
+    std::fill(ctrl_.begin(), ctrl_.end(), kEmpty);
+    size_ = 0;
+    erased_ = 0;
+  }
+
+  // Makes room for n entries without further rehashing.
+  void reserve(size_type n) {
+    size_type capacity = kMinCapacity;
+    while (!fits(n, capacity)) {
+      capacity *= 2;
+    }
+
+    if (capacity > capacity_) {
+      rehash(capacity);
+    }
+  }
+
+ private:
+  static constexpr uint8_t kEmpty = 0;
+  static constexpr uint8_t kErased = 1;
+  static constexpr uint8_t kFull = 0x80;
+  static constexpr size_type kMinCapacity = 8;
+
+  static bool is_full(uint8_t ctrl) { return ctrl & kFull; }
+  static uint8_t full_ctrl(std::size_t h) { return kFull | (h & 0x7f); }
+
+  // The table is kept at most 7/8 full, counting erased slots, so that every
+  // probe sequence ends at an empty slot.
+  static bool fits(size_type n, size_type capacity) {
+    return n * 8 <= capacity * 7;
+  }
+
+  // Scrambles the user hash so that hashes which only differ in their high
+  // bits (e.g., integer IDs) still spread over the table.
+  std::size_t hash(const K& key) const {
+    std::size_t h = hasher_(key) * static_cast<std::size_t>(0x9e3779b97f4a7c15);
+    return h ^ (h >> (sizeof(std::size_t) * 4));
+  }
+
+  size_type home(std::size_t h) const { return (h >> 7) & (capacity_ - 1); }
+
+  // Returns capacity_ if key is not present.
+  size_type find_index(const K& key, std::size_t h) const {
+    if (size_ == 0) {
+      return capacity_;
+    }
+
+    uint8_t ctrl = full_ctrl(h);
+    for (size_type i = home(h);; i = (i + 1) & (capacity_ - 1)) {
+      if (ctrl_[i] == kEmpty) {
+        return capacity_;
+      }
+
+      if (ctrl_[i] == ctrl && equal_(slots_[i].first, key)) {
+        return i;
+      }
+    }
+  }
+
+  // Returns a free slot for a new entry with hash h, growing the table first
+  // if needed.
+  size_type insert_index(std::size_t h) {
+    if (!fits(size_ + erased_ + 1, capacity_)) {
+      // only grow if the table is mostly live entries rather than erased ones
+      rehash(fits(2 * (size_ + 1), capacity_) ? capacity_
+                                              : std::max(capacity_ * 2,
+                                                         kMinCapacity));
+    }
+
+    for (size_type i = home(h);; i = (i + 1) & (capacity_ - 1)) {
+      if (!is_full(ctrl_[i])) {
+        if (ctrl_[i] == kErased) {
+          erased_--;
+        }
+        return i;
+      }
+    }
+  }
+
+  void erase_index(size_type index) {
+    slots_[index].~value_type();
+    size_--;
+
+    // a slot followed by an empty slot ends no probe sequence but its own, so
+    // it can become empty rather than erased
+    if (ctrl_[(index + 1) & (capacity_ - 1)] == kEmpty) {
+      ctrl_[index] = kEmpty;
+    } else {
+      ctrl_[index] = kErased;
+      erased_++;
+    }
+  }
+
+  void rehash(size_type capacity) {
+    std::vector<uint8_t> old_ctrl(capacity, kEmpty);
+    old_ctrl.swap(ctrl_);
+    value_type* old_slots = slots_;
+    size_type old_capacity = capacity_;
+
+    slots_ = allocate(capacity);
+    capacity_ = capacity;
+    erased_ = 0;
+
+    for (size_type i = 0; i < old_capacity; i++) {
+      if (is_full(old_ctrl[i])) {
+        std::size_t h = hash(old_slots[i].first);
+        size_type index = home(h);
+        while (ctrl_[index] != kEmpty) {
+          index = (index + 1) & (capacity_ - 1);
+        }
+
+        new (&slots_[index]) value_type(std::move(old_slots[i]));
+        ctrl_[index] = full_ctrl(h);
+        old_slots[i].~value_type();
+      }
+    }
+
+    deallocate(old_slots, old_capacity);
+  }
+
+  // Inserts an entry whose key is known not to be present.
+  void emplace_unique(const K& key, const V& value) {
+    std::size_t h = hash(key);
+    size_type index = insert_index(h);
+    new (&slots_[index]) value_type(key, value);
+    ctrl_[index] = full_ctrl(h);
+    size_++;
+  }
+
+  void destroy_all() {
+    for (size_type i = 0; i < capacity_ && size_ > 0; i++) {
+      if (is_full(ctrl_[i])) {
+        slots_[i].~value_type();
+      }
+    }
+  }
+
+  static value_type* allocate(size_type n) {
+    return std::allocator<value_type>().allocate(n);
+  }
+
+  static void deallocate(value_type* slots, size_type n) {
+    if (slots != nullptr) {
+      std::allocator<value_type>().deallocate(slots, n);
+    }
+  }
+
+  // one control word per slot: kEmpty, kErased, or kFull plus 7 hash bits
+  std::vector<uint8_t> ctrl_;
+
+  // the entries; only slots with a full control word are constructed
+  value_type* slots_;
+
+  // the number of slots; always 0 or a power of 2
+  size_type capacity_;
+
+  // the number of live entries
+  size_type size_;
+
+  // the number of erased slots, which still lengthen probe sequences
+  size_type erased_;
+
+  H hasher_;
+  E equal_;
+};
+
+template <typename K, typename V, typename H, typename E>
+constexpr uint8_t FlatHashMap<K, V, H, E>::kEmpty;
+
+template <typename K, typename V, typename H, typename E>
+constexpr uint8_t FlatHashMap<K, V, H, E>::kErased;
+
+template <typename K, typename V, typename H, typename E>
+constexpr uint8_t FlatHashMap<K, V, H, E>::kFull;
+
+template <typename K, typename V, typename H, typename E>
+constexpr typename FlatHashMap<K, V, H, E>::size_type
+    FlatHashMap<K, V, H, E>::kMinCapacity;
+
+#endif  // INCLUDE_FLAT_HASH_MAP_HPP_
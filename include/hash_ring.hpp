@@ -0,0 +1,179 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_HASH_RING_HPP_
+#define INCLUDE_HASH_RING_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+
+#include "threads.hpp"
+#include "types.hpp"
+
+// The number of virtual nodes each server thread has on a hash ring.
+const unsigned kVirtualThreadNum = 3000;
+
+// Returns the current storage nodes, each given as its thread 0.
+using MembershipSource = std::function<vector<ServerThread>()>;
+
+// Places nodes and keys on the global (node-level) ring. The prefix keeps the
+// global and local positions of a string apart.
+struct GlobalHasher {
+  uint32_t operator()(const ServerThread& th) const {
+    return std::hash<string>{}("GLOBAL" + th.virtual_id());
+  }
+
+  uint32_t operator()(const Key& key) const {
+    return std::hash<string>{}("GLOBAL" + key);
+  }
+};
+
+// Places threads and keys on the local (thread-level) ring within a node.
+struct LocalHasher {
+  std::size_t operator()(const ServerThread& th) const {
+    return std::hash<string>{}(std::to_string(th.tid()) + "_" +
+                               std::to_string(th.virtual_num()));
+  }
+
+  std::size_t operator()(const Key& key) const {
+    return std::hash<string>{}(key);
+  }
+};
+
+// A consistent hash ring of server threads: a key belongs to the first
+// threads found walking clockwise from the key's position.
+template <typename H>
+class ConsistentHashRing {
+ public:
+  using Ring = std::map<decltype(H()(Key())), ServerThread>;
+
+  void insert(const ServerThread& th) { ring_.emplace(H()(th), th); }
+
+  void clear() { ring_.clear(); }
+
+  bool empty() const { return ring_.empty(); }
+
+  // Returns up to count distinct threads for key, deduplicated by id_of.
+  template <typename F>
+  vector<ServerThread> walk(const Key& key, unsigned count, F id_of) const {
+    vector<ServerThread> result;
+    if (ring_.empty()) {
+      return result;
+    }
+
+    set<string> seen;
+    auto it = ring_.lower_bound(H()(key));
+
+    for (std::size_t i = 0; i < ring_.size() && result.size() < count; i++) {
+      if (it == ring_.end()) {
+        it = ring_.begin();
+      }
+
+      if (seen.insert(id_of(it->second)).second) {
+        result.push_back(it->second);
+      }
+      ++it;
+    }
+
+    return result;
+  }
+
+ private:
+  Ring ring_;
+};
+
+// A ClientHashRing lets a client place keys on storage threads itself rather
+// than asking the routing tier. It mirrors the placement of the servers'
+// memory tier: a key is replicated on global_replication nodes of the global
+// ring and, within each of them, on local_replication threads of the local
+// ring. This only holds for keys with the default replication factors and
+// while the membership is current, so a client using it must still fall back
+// to the routing tier when a server rejects a request.
+class ClientHashRing {
+ public:
+  /**
+   * @threads_per_node The number of storage threads on every node
+   * @global_replication The default number of nodes that hold a key
+   * @local_replication The default number of threads per node that hold a key
+   */
+  ClientHashRing(unsigned threads_per_node, unsigned global_replication = 1,
+                 unsigned local_replication = 1,
+                 unsigned virtual_threads = kVirtualThreadNum) :
+      threads_per_node_(threads_per_node),
+      global_replication_(global_replication),
+      local_replication_(local_replication),
+      virtual_threads_(virtual_threads) {
+    for (unsigned tid = 0; tid < threads_per_node_; tid++) {
+      for (unsigned vnum = 0; vnum < virtual_threads_; vnum++) {
+        local_.insert(ServerThread("", "", tid, vnum));
+      }
+    }
+  }
+
+  /**
+   * Replaces the ring's membership. Each node is given as its thread 0.
+   */
+  void set_members(const vector<ServerThread>& nodes) {
+    global_.clear();
+
+    for (const ServerThread& node : nodes) {
+      for (unsigned vnum = 0; vnum < virtual_threads_; vnum++) {
+        global_.insert(
+            ServerThread(node.public_ip(), node.private_ip(), 0, vnum));
+      }
+    }
+  }
+
+  bool empty() const { return global_.empty(); }
+
+  /**
+   * Returns the key request addresses of the threads responsible for key.
+   */
+  set<Address> responsible_threads(const Key& key) const {
+    set<Address> addresses;
+
+    vector<ServerThread> nodes =
+        global_.walk(key, global_replication_, [](const ServerThread& th) {
+          return th.private_ip();
+        });
+    vector<ServerThread> threads =
+        local_.walk(key, local_replication_, [](const ServerThread& th) {
+          return std::to_string(th.tid());
+        });
+
+    for (const ServerThread& node : nodes) {
+      for (const ServerThread& thread : threads) {
+        addresses.insert(ServerThread(node.public_ip(), node.private_ip(),
+                                      thread.tid())
+                             .key_request_connect_address());
+      }
+    }
+
+    return addresses;
+  }
+
+ private:
+  unsigned threads_per_node_;
+  unsigned global_replication_;
+  unsigned local_replication_;
+  unsigned virtual_threads_;
+
+  ConsistentHashRing<GlobalHasher> global_;
+
+  // the same on every node, since it only depends on the thread IDs
+  ConsistentHashRing<LocalHasher> local_;
+};
+
+#endif  // INCLUDE_HASH_RING_HPP_
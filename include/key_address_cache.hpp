@@ -0,0 +1,299 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_KEY_ADDRESS_CACHE_HPP_
+#define INCLUDE_KEY_ADDRESS_CACHE_HPP_
+
+#include <chrono>
+
+#include "deadline_queue.hpp"
+#include "types.hpp"
+
+// The default number of keys whose worker addresses a client caches.
+const unsigned kDefaultKeyAddressCacheSize = 100000;
+
+// A KeyAddressCache maps keys to the addresses of the worker threads that are
+// responsible for them. It holds at most `capacity` keys and evicts with the
+// CLOCK algorithm: every lookup marks its key as recently used, and when the
+// cache is full the clock hand sweeps over the keys, clearing the marks, until
+// it reaches an unmarked key to evict. Entries can also be given a time to
+// live, after which lookups treat them as missing.
+//
+// The cache also indexes its keys by worker node, so that dropping every key
+// served by a node that may have failed only touches the affected keys.
+// Worker addresses look like "tcp://<ip>:<port>"; a node is identified by the
+// part between the first and second colon, as for the sockets of one node's
+// threads that part is the same.
+class KeyAddressCache {
+ public:
+  /**
+   * @capacity The maximum number of keys held at once
+   * @ttl How long an entry stays valid after its first address is added; 0
+   * disables expiry
+   */
+  explicit KeyAddressCache(
+      unsigned capacity = kDefaultKeyAddressCacheSize,
+      std::chrono::milliseconds ttl = std::chrono::milliseconds(0)) :
+      capacity_(capacity == 0 ? 1 : capacity),
+      ttl_(ttl),
+      hand_(0),
+      hits_(0),
+      misses_(0),
+      evictions_(0),
+      expirations_(0) {}
+
+  /**
+   * Returns the cached addresses for key, or nullptr if the key is not cached
+   * or its entry has expired. The pointer is valid until the cache is next
+   * modified.
+   */
+  const set<Address>* get(const Key& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      misses_++;
+      return nullptr;
+    }
+
+    Entry& entry = entries_[it->second];
+    if (expired(entry)) {
+      remove(it->second);
+      expirations_++;
+      misses_++;
+      return nullptr;
+    }
+
+    entry.referenced_ = true;
+    hits_++;
+    return &entry.addresses_;
+  }
+
+  /**
+   * Returns the number of addresses cached for key without counting a lookup
+   * or refreshing the entry; 0 if the entry has expired.
+   */
+  unsigned address_count(const Key& key) const {
+    const set<Address>* addresses = peek(key);
+    return addresses == nullptr ? 0 : addresses->size();
+  }
+
+  /**
+   * Like get, but neither counts the lookup nor refreshes the entry. An
+   * expired entry is reported as missing but left for get or add to drop.
+   */
+  const set<Address>* peek(const Key& key) const {
+    auto it = index_.find(key);
+    if (it == index_.end() || expired(entries_[it->second])) {
+      return nullptr;
+    }
+
+    return &entries_[it->second].addresses_;
+  }
+
+  /**
+   * Adds a worker address for key, evicting another key if the cache is full.
+   * If the key's entry has expired, its addresses are dropped and address
+   * starts a new entry.
+   */
+  void add(const Key& key, const Address& address) {
+    unsigned slot;
+    auto it = index_.find(key);
+
+    if (it != index_.end() && expired(entries_[it->second])) {
+      remove(it->second);
+      expirations_++;
+      it = index_.end();
+    }
+
+    if (it != index_.end()) {
+      slot = it->second;
+    } else {
+      slot = allocate();
+      Entry& entry = entries_[slot];
+      entry.key_ = key;
+      entry.live_ = true;
+      entry.referenced_ = true;
+      entry.added_ = SteadyClock::now();
+      index_[key] = slot;
+    }
+
+    if (entries_[slot].addresses_.insert(address).second) {
+      node_keys_[node_of(address)].insert(key);
+    }
+  }
+
+  /**
+   * Drops key from the cache.
+   */
+  void erase(const Key& key) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      remove(it->second);
+    }
+  }
+
+  /**
+   * Drops every key that has an address on the same node as worker.
+   */
+  void invalidate_node(const Address& worker) {
+    auto it = node_keys_.find(node_of(worker));
+    if (it == node_keys_.end()) {
+      return;
+    }
+
+    // removing the keys below edits node_keys_, so detach them first
+    set<Key> keys = std::move(it->second);
+    node_keys_.erase(it);
+
+    for (const Key& key : keys) {
+      erase(key);
+    }
+  }
+
+  void clear() {
+    entries_.clear();
+    free_slots_.clear();
+    index_.clear();
+    node_keys_.clear();
+    hand_ = 0;
+  }
+
+  unsigned size() const { return index_.size(); }
+
+  unsigned capacity() const { return capacity_; }
+
+  // Lowering the capacity takes effect as new keys are added.
+  void set_capacity(unsigned capacity) {
+    capacity_ = capacity == 0 ? 1 : capacity;
+  }
+
+  void set_ttl(std::chrono::milliseconds ttl) { ttl_ = ttl; }
+
+  // lookups that found a live entry
+  uint64_t hits() const { return hits_; }
+
+  // lookups that found no entry or an expired one
+  uint64_t misses() const { return misses_; }
+
+  // keys dropped to make room for new ones
+  uint64_t evictions() const { return evictions_; }
+
+  // keys dropped because their time to live ran out
+  uint64_t expirations() const { return expirations_; }
+
+ private:
+  struct Entry {
+    Key key_;
+    set<Address> addresses_;
+    Deadline added_;
+    bool referenced_ = false;
+    bool live_ = false;
+  };
+
+  static string node_of(const Address& address) {
+    size_t begin = address.find(':');
+    if (begin == string::npos) {
+      return address;
+    }
+
+    size_t end = address.find(':', begin + 1);
+    return address.substr(begin + 1, end == string::npos
+                                         ? string::npos
+                                         : end - begin - 1);
+  }
+
+  bool expired(const Entry& entry) const {
+    return ttl_.count() > 0 && SteadyClock::now() - entry.added_ >= ttl_;
+  }
+
+  // Returns an unused slot, evicting a key first if the cache is full.
+  unsigned allocate() {
+    while (index_.size() >= capacity_) {
+      evict();
+    }
+
+    if (!free_slots_.empty()) {
+      unsigned slot = free_slots_.back();
+      free_slots_.pop_back();
+      return slot;
+    }
+
+    entries_.push_back(Entry());
+    return entries_.size() - 1;
+  }
+
+  // Advances the clock hand to the first live, unreferenced entry and removes
+  // it; referenced entries it passes get a second chance.
+  void evict() {
+    while (true) {
+      if (hand_ >= entries_.size()) {
+        hand_ = 0;
+      }
+
+      Entry& entry = entries_[hand_];
+      if (entry.live_) {
+        if (!entry.referenced_ || expired(entry)) {
+          remove(hand_++);
+          evictions_++;
+          return;
+        }
+
+        entry.referenced_ = false;
+      }
+
+      hand_++;
+    }
+  }
+
+  void remove(unsigned slot) {
+    Entry& entry = entries_[slot];
+
+    for (const Address& address : entry.addresses_) {
+      auto it = node_keys_.find(node_of(address));
+      if (it != node_keys_.end()) {
+        it->second.erase(entry.key_);
+        if (it->second.empty()) {
+          node_keys_.erase(it);
+        }
+      }
+    }
+
+    index_.erase(entry.key_);
+    entry = Entry();
+    free_slots_.push_back(slot);
+  }
+
+  // the maximum number of keys
+  unsigned capacity_;
+
+  // how long an entry stays valid; 0 if entries never expire
+  std::chrono::milliseconds ttl_;
+
+  // the clock; free slots are marked as not live
+  vector<Entry> entries_;
+  vector<unsigned> free_slots_;
+  unsigned hand_;
+
+  // the slot of every cached key
+  flat_map<Key, unsigned> index_;
+
+  // the cached keys with an address on each worker node
+  flat_map<string, set<Key>> node_keys_;
+
+  uint64_t hits_;
+  uint64_t misses_;
+  uint64_t evictions_;
+  uint64_t expirations_;
+};
+
+#endif  // INCLUDE_KEY_ADDRESS_CACHE_HPP_
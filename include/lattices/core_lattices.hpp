@@ -15,10 +15,15 @@
 #ifndef INCLUDE_LATTICES_CORE_LATTICES_HPP_
 #define INCLUDE_LATTICES_CORE_LATTICES_HPP_
 
+#include <algorithm>
+#include <iterator>
+
 #include "lattice.hpp"
 #include "types.hpp"
 
-class BoolLattice : public Lattice<bool> {
+class BoolLattice : public Lattice<bool, BoolLattice> {
+  friend class Lattice<bool, BoolLattice>;
+
  protected:
   void do_merge(const bool &e) { element |= e; }
 
@@ -28,19 +33,20 @@ class BoolLattice : public Lattice<bool> {
 };
 
 template <typename T>
-class MaxLattice : public Lattice<T> {
+class MaxLattice : public Lattice<T, MaxLattice<T>> {
+  using Base = Lattice<T, MaxLattice<T>>;
+  friend Base;
+
  protected:
   void do_merge(const T &e) {
-    int current = this->element;
-
-    if (current < e) {
+    if (this->element < e) {
       this->element = e;
     }
   }
 
  public:
-  MaxLattice() : Lattice<T>(T()) {}
-  MaxLattice(const T &e) : Lattice<T>(e) {}
+  MaxLattice() : Base(T()) {}
+  MaxLattice(const T &e) : Base(e) {}
 
   // for now, all non-merge methods are non-destructive
   MaxLattice<T> add(T n) const { return MaxLattice<T>(this->element + n); }
@@ -48,8 +54,29 @@ class MaxLattice : public Lattice<T> {
   MaxLattice<T> subtract(T n) const { return MaxLattice<T>(this->element - n); }
 };
 
+// Moves every element of from that into is missing into into. Under C++17
+// the set nodes are spliced over without copying or reallocating elements.
+template <typename S>
+void splice_into(S &into, S &from) {
+  if (into.empty()) {
+    into.swap(from);
+    return;
+  }
+
+#if __cplusplus >= 201703L
+  into.merge(from);
+#else
+  for (const auto &elem : from) {
+    into.insert(elem);
+  }
+#endif
+}
+
 template <typename T>
-class SetLattice : public Lattice<set<T>> {
+class SetLattice : public Lattice<set<T>, SetLattice<T>> {
+  using Base = Lattice<set<T>, SetLattice<T>>;
+  friend Base;
+
  protected:
   void do_merge(const set<T> &e) {
     for (const T &elem : e) {
@@ -57,25 +84,73 @@ class SetLattice : public Lattice<set<T>> {
     }
   }
 
+  void do_merge(set<T> &&e) { splice_into(this->element, e); }
+
  public:
-  SetLattice() : Lattice<set<T>>(set<T>()) {}
+  SetLattice() : Base(set<T>()) {}
 
-  SetLattice(const set<T> &e) : Lattice<set<T>>(e) {}
+  SetLattice(const set<T> &e) : Base(e) {}
+
+  SetLattice(set<T> &&e) : Base(std::move(e)) {}
 
   MaxLattice<unsigned> size() const { return this->element.size(); }
 
   void insert(T e) { this->element.insert(std::move(e)); }
 
-  SetLattice<T> intersect(set<T> s) const {
+  /**
+   * Returns the elements in both sets. Walks the smaller set and probes the
+   * larger one, so this is linear in the smaller set.
+   */
+  SetLattice<T> intersect(const set<T> &s) const {
+    const set<T> &small = s.size() < this->element.size() ? s : this->element;
+    const set<T> &large = &small == &s ? this->element : s;
     set<T> res;
 
-    for (const T &that_elem : s) {
-      for (const T &this_elem : this->element) {
-        if (this_elem == that_elem) res.insert(this_elem);
-      }
+    for (const T &elem : small) {
+      if (large.find(elem) != large.end()) res.insert(elem);
+    }
+
+    return SetLattice<T>(std::move(res));
+  }
+
+  SetLattice<T> intersect(const SetLattice<T> &other) const {
+    return intersect(other.reveal());
+  }
+
+  /**
+   * Returns the elements in either set, copying the larger set and adding
+   * the smaller one to it.
+   */
+  SetLattice<T> unite(const set<T> &s) const {
+    const set<T> &small = s.size() < this->element.size() ? s : this->element;
+    set<T> res = &small == &s ? this->element : s;
+
+    for (const T &elem : small) {
+      res.insert(elem);
     }
 
-    return SetLattice<T>(res);
+    return SetLattice<T>(std::move(res));
+  }
+
+  SetLattice<T> unite(const SetLattice<T> &other) const {
+    return unite(other.reveal());
+  }
+
+  /**
+   * Returns the elements of this set that are not in s.
+   */
+  SetLattice<T> difference(const set<T> &s) const {
+    set<T> res;
+
+    for (const T &elem : this->element) {
+      if (s.find(elem) == s.end()) res.insert(elem);
+    }
+
+    return SetLattice<T>(std::move(res));
+  }
+
+  SetLattice<T> difference(const SetLattice<T> &other) const {
+    return difference(other.reveal());
   }
 
   SetLattice<T> project(bool (*f)(T)) const {
@@ -85,12 +160,15 @@ class SetLattice : public Lattice<set<T>> {
       if (f(elem)) res.insert(elem);
     }
 
-    return SetLattice<T>(res);
+    return SetLattice<T>(std::move(res));
   }
 };
 
 template <typename T>
-class OrderedSetLattice : public Lattice<ordered_set<T>> {
+class OrderedSetLattice : public Lattice<ordered_set<T>, OrderedSetLattice<T>> {
+  using Base = Lattice<ordered_set<T>, OrderedSetLattice<T>>;
+  friend Base;
+
  protected:
   void do_merge(const ordered_set<T> &e) {
     for (const T &elem : e) {
@@ -98,25 +176,56 @@ class OrderedSetLattice : public Lattice<ordered_set<T>> {
     }
   }
 
+  void do_merge(ordered_set<T> &&e) { splice_into(this->element, e); }
+
  public:
-  OrderedSetLattice() : Lattice<ordered_set<T>>(ordered_set<T>()) {}
+  OrderedSetLattice() : Base(ordered_set<T>()) {}
 
-  OrderedSetLattice(const ordered_set<T> &e) : Lattice<ordered_set<T>>(e) {}
+  OrderedSetLattice(const ordered_set<T> &e) : Base(e) {}
+
+  OrderedSetLattice(ordered_set<T> &&e) : Base(std::move(e)) {}
 
   MaxLattice<unsigned> size() const { return this->element.size(); }
 
   void insert(T e) { this->element.insert(std::move(e)); }
 
-  OrderedSetLattice<T> intersect(ordered_set<T> s) const {
+  // The set operations below walk both sets once in order, appending to the
+  // result at its end, so each is linear in the sizes of the two sets.
+
+  OrderedSetLattice<T> intersect(const ordered_set<T> &s) const {
     ordered_set<T> res;
+    std::set_intersection(this->element.begin(), this->element.end(),
+                          s.begin(), s.end(), std::inserter(res, res.end()),
+                          this->element.key_comp());
+    return OrderedSetLattice<T>(std::move(res));
+  }
 
-    for (const T &that_elem : s) {
-      for (const T &this_elem : this->element) {
-        if (this_elem == that_elem) res.insert(this_elem);
-      }
-    }
+  OrderedSetLattice<T> intersect(const OrderedSetLattice<T> &other) const {
+    return intersect(other.reveal());
+  }
+
+  OrderedSetLattice<T> unite(const ordered_set<T> &s) const {
+    ordered_set<T> res;
+    std::set_union(this->element.begin(), this->element.end(), s.begin(),
+                   s.end(), std::inserter(res, res.end()),
+                   this->element.key_comp());
+    return OrderedSetLattice<T>(std::move(res));
+  }
+
+  OrderedSetLattice<T> unite(const OrderedSetLattice<T> &other) const {
+    return unite(other.reveal());
+  }
+
+  OrderedSetLattice<T> difference(const ordered_set<T> &s) const {
+    ordered_set<T> res;
+    std::set_difference(this->element.begin(), this->element.end(),
+                        s.begin(), s.end(), std::inserter(res, res.end()),
+                        this->element.key_comp());
+    return OrderedSetLattice<T>(std::move(res));
+  }
 
-    return OrderedSetLattice<T>(res);
+  OrderedSetLattice<T> difference(const OrderedSetLattice<T> &other) const {
+    return difference(other.reveal());
   }
 
   OrderedSetLattice<T> project(bool (*f)(T)) const {
@@ -126,12 +235,15 @@ class OrderedSetLattice : public Lattice<ordered_set<T>> {
       if (f(elem)) res.insert(elem);
     }
 
-    return OrderedSetLattice<T>(res);
+    return OrderedSetLattice<T>(std::move(res));
   }
 };
 
 template <typename K, typename V>
-class MapLattice : public Lattice<map<K, V>> {
+class MapLattice : public Lattice<map<K, V>, MapLattice<K, V>> {
+  using Base = Lattice<map<K, V>, MapLattice<K, V>>;
+  friend Base;
+
  protected:
   void insert_pair(const K &k, const V &v) {
     auto search = this->element.find(k);
@@ -139,8 +251,16 @@ class MapLattice : public Lattice<map<K, V>> {
       static_cast<V *>(&(search->second))->merge(v);
     } else {
       // need to copy v since we will be "growing" it within the lattice
-      V new_v = v;
-      this->element.emplace(k, new_v);
+      this->element.emplace(k, v);
+    }
+  }
+
+  void insert_pair(const K &k, V &&v) {
+    auto search = this->element.find(k);
+    if (search != this->element.end()) {
+      static_cast<V *>(&(search->second))->merge(std::move(v));
+    } else {
+      this->element.emplace(k, std::move(v));
     }
   }
 
@@ -150,19 +270,40 @@ class MapLattice : public Lattice<map<K, V>> {
     }
   }
 
+  void do_merge(map<K, V> &&m) {
+    if (this->element.empty()) {
+      this->element.swap(m);
+      return;
+    }
+
+    for (auto &pair : m) {
+      this->insert_pair(pair.first, std::move(pair.second));
+    }
+  }
+
  public:
-  MapLattice() : Lattice<map<K, V>>(map<K, V>()) {}
-  MapLattice(const map<K, V> &m) : Lattice<map<K, V>>(m) {}
+  MapLattice() : Base(map<K, V>()) {}
+  MapLattice(const map<K, V> &m) : Base(m) {}
+  MapLattice(map<K, V> &&m) : Base(std::move(m)) {}
   MaxLattice<unsigned> size() const { return this->element.size(); }
 
-  MapLattice<K, V> intersect(MapLattice<K, V> other) const {
+  /**
+   * Returns the keys in both maps, each with the merge of its two values.
+   * Walks the smaller map and probes the larger one.
+   */
+  MapLattice<K, V> intersect(const MapLattice<K, V> &other) const {
+    const map<K, V> &small = other.reveal().size() < this->element.size()
+                                 ? other.reveal()
+                                 : this->element;
+    const map<K, V> &large =
+        &small == &this->element ? other.reveal() : this->element;
     MapLattice<K, V> res;
-    map<K, V> m = other.reveal();
 
-    for (const auto &pair : m) {
-      if (this->contains(pair.first).reveal()) {
-        res.insert_pair(pair.first, this->at(pair.first));
+    for (const auto &pair : small) {
+      auto it = large.find(pair.first);
+      if (it != large.end()) {
         res.insert_pair(pair.first, pair.second);
+        res.insert_pair(pair.first, it->second);
       }
     }
 
@@ -174,7 +315,7 @@ class MapLattice : public Lattice<map<K, V>> {
     for (const auto &pair : this->element) {
       if (f(pair.second)) res.emplace(pair.first, pair.second);
     }
-    return MapLattice<K, V>(res);
+    return MapLattice<K, V>(std::move(res));
   }
 
   BoolLattice contains(K k) const {
@@ -190,7 +331,7 @@ class MapLattice : public Lattice<map<K, V>> {
     for (const auto &pair : this->element) {
       res.insert(pair.first);
     }
-    return SetLattice<K>(res);
+    return SetLattice<K>(std::move(res));
   }
 
   V &at(K k) { return this->element[k]; }
@@ -201,6 +342,8 @@ class MapLattice : public Lattice<map<K, V>> {
   }
 
   void insert(const K &k, const V &v) { this->insert_pair(k, v); }
+
+  void insert(const K &k, V &&v) { this->insert_pair(k, std::move(v)); }
 };
 
 #endif  // INCLUDE_LATTICES_CORE_LATTICES_HPP_
@@ -0,0 +1,99 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_LATTICES_DELTA_TRACKER_HPP_
+#define INCLUDE_LATTICES_DELTA_TRACKER_HPP_
+
+#include <utility>
+
+// A DeltaTracker holds a lattice L together with the delta of its local
+// updates since the last flush: the join of every value merged or inserted
+// locally. Joining the delta into any replica that has seen the state as of
+// the last flush brings it up to date, so a writer only needs to ship the
+// delta instead of the whole state. Values merged in from elsewhere with
+// merge() are assumed to be stored already and are left out of the delta.
+//
+// L must be default-constructible to its bottom element, as the set and map
+// lattices are.
+template <typename L>
+class DeltaTracker {
+ public:
+  DeltaTracker() : dirty_(false) {}
+
+  // state is taken to be stored already, so the delta starts out empty.
+  explicit DeltaTracker(const L &state) : state_(state), dirty_(false) {}
+
+  explicit DeltaTracker(L &&state) : state_(std::move(state)), dirty_(false) {}
+
+  const L &state() const { return state_; }
+
+  const L &delta() const { return delta_; }
+
+  // Whether anything was updated locally since the last flush.
+  bool has_delta() const { return dirty_; }
+
+  /**
+   * Inserts into the state and records the insert in the delta. The
+   * arguments are those of L::insert.
+   */
+  template <typename... Args>
+  void insert(const Args &... args) {
+    state_.insert(args...);
+    delta_.insert(args...);
+    dirty_ = true;
+  }
+
+  /**
+   * Merges a local update into the state and records it in the delta.
+   */
+  void update(const L &change) {
+    state_.merge(change);
+    delta_.merge(change);
+    dirty_ = true;
+  }
+
+  /**
+   * Merges a value that is already stored elsewhere, e.g. the result of a
+   * GET, into the state only.
+   */
+  void merge(const L &remote) { state_.merge(remote); }
+
+  void merge(L &&remote) { state_.merge(std::move(remote)); }
+
+  /**
+   * Returns the delta and starts a new, empty one.
+   */
+  L flush() {
+    L delta = std::move(delta_);
+    delta_ = L();
+    dirty_ = false;
+    return delta;
+  }
+
+  /**
+   * Puts back a flushed delta that failed to be written, so that the next
+   * flush includes it again.
+   */
+  void restore(L &&delta) {
+    delta_.merge(std::move(delta));
+    dirty_ = true;
+  }
+
+ private:
+  L state_;
+  L delta_;
+  bool dirty_;
+};
+
+#endif  // INCLUDE_LATTICES_DELTA_TRACKER_HPP_
@@ -0,0 +1,320 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_LATTICES_FLAT_VECTOR_CLOCK_HPP_
+#define INCLUDE_LATTICES_FLAT_VECTOR_CLOCK_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "vector_clock.hpp"
+
+// The ID a FlatVectorClock stores in place of a node's name.
+using NodeId = uint32_t;
+
+// A NodeIdTable interns node names, handing out dense IDs in the order names
+// are first seen. There is a single table per process, so IDs are only
+// meaningful within one process; clocks are converted back to names before
+// they are sent anywhere.
+//
+// An ID never changes once it has been handed out, so each thread keeps its
+// own cache of the names and IDs it has looked up. Only the first lookup of a
+// name or ID on a thread takes the table's lock.
+class NodeIdTable {
+ public:
+  static NodeIdTable &get() {
+    static NodeIdTable table;
+    return table;
+  }
+
+  NodeId intern(const string &name) {
+    LocalCache &cache = local_cache();
+    auto cached = cache.ids.find(name);
+    if (cached != cache.ids.end()) {
+      return cached->second;
+    }
+
+    NodeId id;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      auto it = ids_.find(name);
+      if (it != ids_.end()) {
+        id = it->second;
+      } else {
+        id = names_.size();
+        names_.push_back(name);
+        ids_.emplace(name, id);
+      }
+    }
+
+    cache.ids.emplace(name, id);
+    return id;
+  }
+
+  // Sets id to the ID of name without interning it; returns false if name
+  // has never been interned.
+  bool find(const string &name, NodeId *id) {
+    LocalCache &cache = local_cache();
+    auto cached = cache.ids.find(name);
+    if (cached != cache.ids.end()) {
+      *id = cached->second;
+      return true;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      auto it = ids_.find(name);
+      if (it == ids_.end()) {
+        return false;
+      }
+
+      *id = it->second;
+    }
+
+    cache.ids.emplace(name, *id);
+    return true;
+  }
+
+  // The reference stays valid for the life of the process.
+  const string &name(NodeId id) {
+    LocalCache &cache = local_cache();
+    if (id >= cache.names.size()) {
+      // names_ is a deque, so the strings it holds never move and the cache
+      // can point into it
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (size_t i = cache.names.size(); i < names_.size(); i++) {
+        cache.names.push_back(&names_[i]);
+      }
+    }
+
+    return *cache.names[id];
+  }
+
+ private:
+  // The names and IDs one thread has already looked up.
+  struct LocalCache {
+    map<string, NodeId> ids;
+    vector<const string *> names;
+  };
+
+  // The table is a singleton, so one cache per thread suffices.
+  static LocalCache &local_cache() {
+    static thread_local LocalCache cache;
+    return cache;
+  }
+
+  std::mutex mutex_;
+  map<string, NodeId> ids_;
+  std::deque<string> names_;
+};
+
+// The entries of a FlatVectorClock, sorted by node ID. IDs and counters are
+// kept in separate arrays so that clocks over the same nodes are merged and
+// compared by plain loops over the counters, which the compiler vectorizes.
+struct ClockEntries {
+  vector<NodeId> ids;
+  vector<unsigned> counters;
+
+  bool operator==(const ClockEntries &other) const {
+    return ids == other.ids && counters == other.counters;
+  }
+};
+
+// A FlatVectorClock is a vector clock laid out as a sorted flat array of
+// (interned node ID, counter) pairs instead of a hash map from node names to
+// MaxLattices. Merging two clocks and testing one against another are single
+// linear passes, and the common case of two clocks over the same set of nodes
+// touches only the counter arrays. It converts to and from VectorClock and,
+// in common.hpp, the protobuf vector clock maps.
+class FlatVectorClock : public Lattice<ClockEntries, FlatVectorClock> {
+  using Base = Lattice<ClockEntries, FlatVectorClock>;
+  friend Base;
+
+ protected:
+  /**
+   * Compares this clock with other in one pass. ahead is set if some counter
+   * of this clock is above other's, behind if some counter is below it;
+   * missing entries count as 0.
+   */
+  void scan(const FlatVectorClock &other, bool *ahead, bool *behind) const {
+    const ClockEntries &a = this->element;
+    const ClockEntries &b = other.element;
+
+    if (a.ids == b.ids) {
+      // accumulate without branching so that the loop vectorizes
+      unsigned any_ahead = 0, any_behind = 0;
+      for (size_t i = 0; i < a.counters.size(); i++) {
+        any_ahead |= a.counters[i] > b.counters[i];
+        any_behind |= a.counters[i] < b.counters[i];
+      }
+
+      *ahead = any_ahead;
+      *behind = any_behind;
+      return;
+    }
+
+    *ahead = false;
+    *behind = false;
+
+    size_t i = 0, j = 0;
+    while (i < a.ids.size() || j < b.ids.size()) {
+      if (j == b.ids.size() || (i < a.ids.size() && a.ids[i] < b.ids[j])) {
+        *ahead |= a.counters[i++] > 0;
+      } else if (i == a.ids.size() || b.ids[j] < a.ids[i]) {
+        *behind |= b.counters[j++] > 0;
+      } else {
+        *ahead |= a.counters[i] > b.counters[j];
+        *behind |= a.counters[i++] < b.counters[j++];
+      }
+    }
+  }
+
+  void do_merge(const ClockEntries &e) {
+    if (this->element.ids == e.ids) {
+      unsigned *counters = this->element.counters.data();
+      const unsigned *other = e.counters.data();
+
+      for (size_t i = 0; i < e.counters.size(); i++) {
+        counters[i] = std::max(counters[i], other[i]);
+      }
+      return;
+    }
+
+    ClockEntries merged;
+    merged.ids.reserve(this->element.ids.size() + e.ids.size());
+    merged.counters.reserve(this->element.ids.size() + e.ids.size());
+
+    size_t i = 0, j = 0;
+    while (i < this->element.ids.size() || j < e.ids.size()) {
+      if (j == e.ids.size() ||
+          (i < this->element.ids.size() && this->element.ids[i] < e.ids[j])) {
+        merged.ids.push_back(this->element.ids[i]);
+        merged.counters.push_back(this->element.counters[i++]);
+      } else if (i == this->element.ids.size() ||
+                 e.ids[j] < this->element.ids[i]) {
+        merged.ids.push_back(e.ids[j]);
+        merged.counters.push_back(e.counters[j++]);
+      } else {
+        merged.ids.push_back(e.ids[j]);
+        merged.counters.push_back(
+            std::max(this->element.counters[i++], e.counters[j++]));
+      }
+    }
+
+    this->element = std::move(merged);
+  }
+
+ public:
+  FlatVectorClock() : Base(ClockEntries()) {}
+
+  explicit FlatVectorClock(const VectorClock &vc) : Base(ClockEntries()) {
+    for (const auto &pair : vc.reveal()) {
+      insert(pair.first, pair.second.reveal());
+    }
+  }
+
+  MaxLattice<unsigned> size() const { return this->element.ids.size(); }
+
+  /**
+   * Returns the counter for node, or 0 if the clock has no entry for it.
+   */
+  unsigned at(NodeId node) const {
+    auto it = std::lower_bound(this->element.ids.begin(),
+                               this->element.ids.end(), node);
+    if (it == this->element.ids.end() || *it != node) {
+      return 0;
+    }
+
+    return this->element.counters[it - this->element.ids.begin()];
+  }
+
+  // Looking up a node no clock has seen does not grow the table.
+  unsigned at(const string &node) const {
+    NodeId id;
+    if (!NodeIdTable::get().find(node, &id)) {
+      return 0;
+    }
+
+    return at(id);
+  }
+
+  /**
+   * Merges counter into the entry for node, as VectorClock::insert does.
+   */
+  void insert(NodeId node, unsigned counter) {
+    auto it = std::lower_bound(this->element.ids.begin(),
+                               this->element.ids.end(), node);
+    size_t index = it - this->element.ids.begin();
+
+    if (it != this->element.ids.end() && *it == node) {
+      this->element.counters[index] =
+          std::max(this->element.counters[index], counter);
+    } else {
+      this->element.ids.insert(it, node);
+      this->element.counters.insert(
+          this->element.counters.begin() + index, counter);
+    }
+  }
+
+  void insert(const string &node, unsigned counter) {
+    insert(NodeIdTable::get().intern(node), counter);
+  }
+
+  /**
+   * Orders this clock against other in one pass.
+   */
+  ClockOrder compare_to(const FlatVectorClock &other) const {
+    bool ahead, behind;
+    scan(other, &ahead, &behind);
+    return to_clock_order(ahead, behind);
+  }
+
+  /**
+   * Returns true if no counter of other is above the matching one of this
+   * clock, i.e. this clock has seen every event other has.
+   */
+  bool dominates(const FlatVectorClock &other) const {
+    ClockOrder order = compare_to(other);
+    return order == ClockOrder::GREATER || order == ClockOrder::EQUAL;
+  }
+
+  /**
+   * Returns true if each clock has seen an event the other has not.
+   */
+  bool concurrent_with(const FlatVectorClock &other) const {
+    return compare_to(other) == ClockOrder::CONCURRENT;
+  }
+
+  VectorClock to_vector_clock() const {
+    VectorClock vc;
+    NodeIdTable &table = NodeIdTable::get();
+
+    for (size_t i = 0; i < this->element.ids.size(); i++) {
+      vc.insert(table.name(this->element.ids[i]),
+                MaxLattice<unsigned>(this->element.counters[i]));
+    }
+
+    return vc;
+  }
+};
+
+inline ClockOrder compare(const FlatVectorClock &a, const FlatVectorClock &b) {
+  return a.compare_to(b);
+}
+
+#endif  // INCLUDE_LATTICES_FLAT_VECTOR_CLOCK_HPP_
@@ -15,38 +15,95 @@
 #ifndef INCLUDE_LATTICES_LATTICE_HPP_
 #define INCLUDE_LATTICES_LATTICE_HPP_
 
-template <typename T>
+#include <utility>
+
+// Lattice is the base of every lattice. Derived names the concrete lattice
+// (the curiously recurring template pattern), and merges call its do_merge
+// directly instead of through a vtable, so nested lattices such as a
+// MapLattice of MaxLattices merge without indirect calls and carry no vtable
+// pointer per element. A concrete lattice derives from Lattice<T, Self> and
+// befriends it, and provides
+//
+//   void do_merge(const T &e);
+//
+// plus, optionally, void do_merge(T &&e) to take over e's storage; rvalues
+// bind to the const overload otherwise.
+//
+// Lattice<T> without a second argument is the dynamically dispatched base
+// that lattices used to derive from; it is kept for lattices that need to be
+// used through a base reference.
+template <typename T, typename Derived = void>
 class Lattice {
  protected:
   T element;
-  virtual void do_merge(const T &e) = 0;
 
  public:
   // Lattice<T>() { assign(bot()); }
 
-  Lattice<T>(const T &e) { assign(e); }
+  Lattice(const T &e) : element(e) {}
+
+  Lattice(T &&e) : element(std::move(e)) {}
 
-  Lattice<T>(const Lattice<T> &other) { assign(other.reveal()); }
+  Lattice(const Lattice &other) : element(other.element) {}
 
-  virtual ~Lattice<T>() = default;
-  Lattice<T> &operator=(const Lattice<T> &rhs) {
-    assign(rhs.reveal());
+  Lattice(Lattice &&other) : element(std::move(other.element)) {}
+
+  Lattice &operator=(const Lattice &rhs) {
+    element = rhs.element;
+    return *this;
+  }
+
+  Lattice &operator=(Lattice &&rhs) {
+    element = std::move(rhs.element);
     return *this;
   }
 
-  bool operator==(const Lattice<T> &rhs) const {
+  bool operator==(const Lattice &rhs) const {
     return this->reveal() == rhs.reveal();
   }
 
   const T &reveal() const { return element; }
 
-  void merge(const T &e) { return do_merge(e); }
+  void merge(const T &e) { return derived().do_merge(e); }
+
+  void merge(T &&e) { return derived().do_merge(std::move(e)); }
+
+  void merge(const Lattice &e) { return derived().do_merge(e.element); }
+
+  void merge(Lattice &&e) { return derived().do_merge(std::move(e.element)); }
 
-  void merge(const Lattice<T> &e) { return do_merge(e.reveal()); }
+  void assign(const T &e) { element = e; }
+
+  void assign(T &&e) { element = std::move(e); }
+
+  void assign(const Lattice &e) { element = e.reveal(); }
+
+  void assign(Lattice &&e) { element = std::move(e.element); }
+
+ private:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+};
+
+template <typename T>
+class Lattice<T, void> : public Lattice<T, Lattice<T, void>> {
+  friend class Lattice<T, Lattice<T, void>>;
+
+ protected:
+  virtual void do_merge(const T &e) = 0;
+
+  // Merges an element the caller no longer needs. Lattices that can take
+  // over parts of e instead of copying them override this.
+  virtual void do_merge(T &&e) { do_merge(static_cast<const T &>(e)); }
+
+ public:
+  using Lattice<T, Lattice<T, void>>::Lattice;
 
-  void assign(const T e) { element = e; }
+  Lattice(const Lattice &other) = default;
+  Lattice(Lattice &&other) = default;
+  Lattice &operator=(const Lattice &rhs) = default;
+  Lattice &operator=(Lattice &&rhs) = default;
 
-  void assign(const Lattice<T> &e) { element = e.reveal(); }
+  virtual ~Lattice() = default;
 };
 
 #endif  // INCLUDE_LATTICES_LATTICE_HPP_
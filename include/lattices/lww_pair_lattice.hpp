@@ -22,26 +22,29 @@ struct TimestampValuePair {
   unsigned long long timestamp{0};
   T value;
 
-  TimestampValuePair<T>() {
+  TimestampValuePair() {
     timestamp = 0;
     value = T();
   }
 
   // need this because of static cast
-  TimestampValuePair<T>(const unsigned long long& a) {
+  TimestampValuePair(const unsigned long long& a) {
     timestamp = 0;
     value = T();
   }
 
-  TimestampValuePair<T>(const unsigned long long& ts, const T& v) {
-    timestamp = ts;
-    value = v;
-  }
+  TimestampValuePair(const unsigned long long& ts, T v) :
+      timestamp(ts),
+      value(std::move(v)) {}
   unsigned size() { return value.size() + sizeof(unsigned long long); }
 };
 
 template <typename T>
-class LWWPairLattice : public Lattice<TimestampValuePair<T>> {
+class LWWPairLattice
+    : public Lattice<TimestampValuePair<T>, LWWPairLattice<T>> {
+  using Base = Lattice<TimestampValuePair<T>, LWWPairLattice<T>>;
+  friend Base;
+
  protected:
   void do_merge(const TimestampValuePair<T>& p) {
     if (p.timestamp >= this->element.timestamp) {
@@ -50,10 +53,17 @@ class LWWPairLattice : public Lattice<TimestampValuePair<T>> {
     }
   }
 
+  void do_merge(TimestampValuePair<T>&& p) {
+    if (p.timestamp >= this->element.timestamp) {
+      this->element.timestamp = p.timestamp;
+      this->element.value = std::move(p.value);
+    }
+  }
+
  public:
-  LWWPairLattice() : Lattice<TimestampValuePair<T>>(TimestampValuePair<T>()) {}
-  LWWPairLattice(const TimestampValuePair<T>& p) :
-      Lattice<TimestampValuePair<T>>(p) {}
+  LWWPairLattice() : Base(TimestampValuePair<T>()) {}
+  LWWPairLattice(const TimestampValuePair<T>& p) : Base(p) {}
+  LWWPairLattice(TimestampValuePair<T>&& p) : Base(std::move(p)) {}
   MaxLattice<unsigned> size() { return {this->element.size()}; }
 };
 
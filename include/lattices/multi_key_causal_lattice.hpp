@@ -15,9 +15,7 @@
 #ifndef INCLUDE_LATTICES_MULTI_KEY_CAUSAL_LATTICE_HPP
 #define INCLUDE_LATTICES_MULTI_KEY_CAUSAL_LATTICE_HPP
 
-#include "core_lattices.hpp"
-
-using VectorClock = MapLattice<string, MaxLattice<unsigned>>;
+#include "vector_clock.hpp"
 
 template <typename T>
 struct MultiKeyCausalPayload {
@@ -25,25 +23,24 @@ struct MultiKeyCausalPayload {
   MapLattice<Key, VectorClock> dependencies;
   T value;
 
-  MultiKeyCausalPayload<T>() {
+  MultiKeyCausalPayload() {
     vector_clock = VectorClock();
     dependencies = MapLattice<Key, VectorClock>();
     value = T();
   }
 
   // need this because of static cast
-  MultiKeyCausalPayload<T>(unsigned) {
+  MultiKeyCausalPayload(unsigned) {
     vector_clock = VectorClock();
     dependencies = MapLattice<Key, VectorClock>();
     value = T();
   }
 
-  MultiKeyCausalPayload<T>(VectorClock vc, MapLattice<Key, VectorClock> dep,
-                           T v) {
-    vector_clock = vc;
-    dependencies = dep;
-    value = v;
-  }
+  MultiKeyCausalPayload(VectorClock vc, MapLattice<Key, VectorClock> dep,
+                        T v) :
+      vector_clock(std::move(vc)),
+      dependencies(std::move(dep)),
+      value(std::move(v)) {}
 
   unsigned size() {
     unsigned dep_size = 0;
@@ -57,28 +54,44 @@ struct MultiKeyCausalPayload {
 };
 
 template <typename T>
-class MultiKeyCausalLattice : public Lattice<MultiKeyCausalPayload<T>> {
+class MultiKeyCausalLattice
+    : public Lattice<MultiKeyCausalPayload<T>, MultiKeyCausalLattice<T>> {
+  using Base = Lattice<MultiKeyCausalPayload<T>, MultiKeyCausalLattice<T>>;
+  friend Base;
+
  protected:
-  void do_merge(const MultiKeyCausalPayload<T> &p) {
-    VectorClock prev = this->element.vector_clock;
-    this->element.vector_clock.merge(p.vector_clock);
+  void do_merge(const MultiKeyCausalPayload<T> &p) { merge_payload(p); }
+
+  void do_merge(MultiKeyCausalPayload<T> &&p) {
+    merge_payload(std::move(p));
+  }
 
-    if (this->element.vector_clock == p.vector_clock) {
-      // incoming version is dominating
-      this->element.dependencies.assign(p.dependencies);
-      this->element.value.assign(p.value);
-    } else if (!(this->element.vector_clock == prev)) {
-      // versions are concurrent
-      this->element.dependencies.merge(p.dependencies);
-      this->element.value.merge(p.value);
+  // Shared by both do_merge overloads; the clock, the dependencies and the
+  // value are moved out of p if p is an rvalue.
+  template <typename P>
+  void merge_payload(P &&p) {
+    switch (causal_merge(this->element.vector_clock, p.vector_clock)) {
+      case CausalMerge::ASSIGN:
+        // incoming version is dominating
+        this->element.vector_clock.assign(std::forward<P>(p).vector_clock);
+        this->element.dependencies.assign(std::forward<P>(p).dependencies);
+        this->element.value.assign(std::forward<P>(p).value);
+        break;
+      case CausalMerge::MERGE:
+        // versions are concurrent
+        this->element.vector_clock.merge(p.vector_clock);
+        this->element.dependencies.merge(std::forward<P>(p).dependencies);
+        this->element.value.merge(std::forward<P>(p).value);
+        break;
+      case CausalMerge::KEEP:
+        break;
     }
   }
 
  public:
-  MultiKeyCausalLattice() :
-      Lattice<MultiKeyCausalPayload<T>>(MultiKeyCausalPayload<T>()) {}
-  MultiKeyCausalLattice(const MultiKeyCausalPayload<T> &p) :
-      Lattice<MultiKeyCausalPayload<T>>(p) {}
+  MultiKeyCausalLattice() : Base(MultiKeyCausalPayload<T>()) {}
+  MultiKeyCausalLattice(const MultiKeyCausalPayload<T> &p) : Base(p) {}
+  MultiKeyCausalLattice(MultiKeyCausalPayload<T> &&p) : Base(std::move(p)) {}
   MaxLattice<unsigned> size() { return {this->element.size()}; }
 };
 
@@ -15,6 +15,8 @@
 #ifndef INCLUDE_LATTICES_PRIORITY_LATTICE_HPP_
 #define INCLUDE_LATTICES_PRIORITY_LATTICE_HPP_
 
+#include <climits>
+
 #include "core_lattices.hpp"
 
 template <class P, class V>
@@ -23,29 +25,42 @@ struct PriorityValuePair {
   V value;
 
   // Initialize at a high value since the merge logic is taking the minimum
-  PriorityValuePair(P p = INT_MAX, V v = {}) : priority(p), value(v) {}
+  PriorityValuePair(P p = INT_MAX, V v = {}) :
+      priority(p),
+      value(std::move(v)) {}
 
   unsigned size() { return sizeof(P) + value.size(); }
 };
 
 template <class P, class V, class Compare = std::less<P>>
-class PriorityLattice : public Lattice<PriorityValuePair<P, V>> {
+class PriorityLattice
+    : public Lattice<PriorityValuePair<P, V>, PriorityLattice<P, V, Compare>> {
   using Element = PriorityValuePair<P, V>;
-  using Base = Lattice<Element>;
+  using Base = Lattice<Element, PriorityLattice<P, V, Compare>>;
+  friend Base;
 
  protected:
-  void do_merge(const Element& p) override {
+  void do_merge(const Element& p) {
     Compare compare;
     if (compare(p.priority, this->element.priority)) {
       this->element = p;
     }
   }
 
+  void do_merge(Element&& p) {
+    Compare compare;
+    if (compare(p.priority, this->element.priority)) {
+      this->element = std::move(p);
+    }
+  }
+
  public:
   PriorityLattice() : Base(Element()) {}
 
   PriorityLattice(const Element& p) : Base(p) {}
 
+  PriorityLattice(Element&& p) : Base(std::move(p)) {}
+
   MaxLattice<unsigned> size() { return {this->element.size()}; }
 };
 
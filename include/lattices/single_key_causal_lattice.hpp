@@ -15,30 +15,27 @@
 #ifndef INCLUDE_LATTICES_SINGLE_KEY_CAUSAL_LATTICE_HPP
 #define INCLUDE_LATTICES_SINGLE_KEY_CAUSAL_LATTICE_HPP
 
-#include "core_lattices.hpp"
-
-using VectorClock = MapLattice<string, MaxLattice<unsigned>>;
+#include "vector_clock.hpp"
 
 template <typename T>
 struct VectorClockValuePair {
   VectorClock vector_clock;
   T value;
 
-  VectorClockValuePair<T>() {
+  VectorClockValuePair() {
     vector_clock = VectorClock();
     value = T();
   }
 
   // need this because of static cast
-  VectorClockValuePair<T>(unsigned) {
+  VectorClockValuePair(unsigned) {
     vector_clock = VectorClock();
     value = T();
   }
 
-  VectorClockValuePair<T>(VectorClock vc, T v) {
-    vector_clock = vc;
-    value = v;
-  }
+  VectorClockValuePair(VectorClock vc, T v) :
+      vector_clock(std::move(vc)),
+      value(std::move(v)) {}
 
   unsigned size() {
     return vector_clock.size().reveal() * 2 * sizeof(unsigned) +
@@ -47,24 +44,39 @@ struct VectorClockValuePair {
 };
 
 template <typename T>
-class SingleKeyCausalLattice : public Lattice<VectorClockValuePair<T>> {
+class SingleKeyCausalLattice
+    : public Lattice<VectorClockValuePair<T>, SingleKeyCausalLattice<T>> {
+  using Base = Lattice<VectorClockValuePair<T>, SingleKeyCausalLattice<T>>;
+  friend Base;
+
  protected:
-  void do_merge(const VectorClockValuePair<T> &p) {
-    VectorClock prev = this->element.vector_clock;
-    this->element.vector_clock.merge(p.vector_clock);
+  void do_merge(const VectorClockValuePair<T> &p) { merge_pair(p); }
+
+  void do_merge(VectorClockValuePair<T> &&p) { merge_pair(std::move(p)); }
 
-    if (this->element.vector_clock == p.vector_clock) {
-      this->element.value.assign(p.value);
-    } else if (!(this->element.vector_clock == prev)) {
-      this->element.value.merge(p.value);
+  // Shared by both do_merge overloads; the clock and the value are moved out
+  // of p if p is an rvalue.
+  template <typename P>
+  void merge_pair(P &&p) {
+    switch (causal_merge(this->element.vector_clock, p.vector_clock)) {
+      case CausalMerge::ASSIGN:
+        // incoming version is dominating
+        this->element.vector_clock.assign(std::forward<P>(p).vector_clock);
+        this->element.value.assign(std::forward<P>(p).value);
+        break;
+      case CausalMerge::MERGE:
+        this->element.vector_clock.merge(p.vector_clock);
+        this->element.value.merge(std::forward<P>(p).value);
+        break;
+      case CausalMerge::KEEP:
+        break;
     }
   }
 
  public:
-  SingleKeyCausalLattice() :
-      Lattice<VectorClockValuePair<T>>(VectorClockValuePair<T>()) {}
-  SingleKeyCausalLattice(const VectorClockValuePair<T> &p) :
-      Lattice<VectorClockValuePair<T>>(p) {}
+  SingleKeyCausalLattice() : Base(VectorClockValuePair<T>()) {}
+  SingleKeyCausalLattice(const VectorClockValuePair<T> &p) : Base(p) {}
+  SingleKeyCausalLattice(VectorClockValuePair<T> &&p) : Base(std::move(p)) {}
   MaxLattice<unsigned> size() { return {this->element.size()}; }
 };
 
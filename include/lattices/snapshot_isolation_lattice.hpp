@@ -25,26 +25,25 @@ struct SnapshotIsolationPayload {
     uint64_t snapshot;
     T value;
 
-    SnapshotIsolationPayload<T>() {
+    SnapshotIsolationPayload() {
         snapshot = minSITimeStamp;
         value = T();
     }
 
   // need this because of static cast
-  SnapshotIsolationPayload<T>(unsigned) {
+  SnapshotIsolationPayload(unsigned) {
       snapshot = minSITimeStamp;
       value = T();
   }
 
-    SnapshotIsolationPayload<T>(uint64_t timestamp) {
+    SnapshotIsolationPayload(uint64_t timestamp) {
         snapshot = timestamp;
         value = T();
     }
 
-    SnapshotIsolationPayload<T>(uint64_t timestamp, T v) {
-        snapshot = timestamp;
-        value = v;
-    }
+    SnapshotIsolationPayload(uint64_t timestamp, T v) :
+        snapshot(timestamp),
+        value(std::move(v)) {}
 
 
 
@@ -54,7 +53,12 @@ struct SnapshotIsolationPayload {
 };
 
 template <typename T>
-class SnapshotIsolationLattice : public Lattice<SnapshotIsolationPayload<T>> {
+class SnapshotIsolationLattice
+    : public Lattice<SnapshotIsolationPayload<T>, SnapshotIsolationLattice<T>> {
+  using Base =
+      Lattice<SnapshotIsolationPayload<T>, SnapshotIsolationLattice<T>>;
+  friend Base;
+
  protected:
   void do_merge(const SnapshotIsolationPayload<T> &p) {
         // Current version is more recent
@@ -64,16 +68,29 @@ class SnapshotIsolationLattice : public Lattice<SnapshotIsolationPayload<T>> {
         }
   }
 
+  void do_merge(SnapshotIsolationPayload<T> &&p) {
+        if (this->element.snapshot > p.snapshot){
+            this->element.snapshot = p.snapshot;
+            this->element.value = std::move(p.value);
+        }
+  }
+
  public:
     SnapshotIsolationLattice() :
-      Lattice<SnapshotIsolationPayload<T>>(SnapshotIsolationPayload<T>()) {}
+      Base(SnapshotIsolationPayload<T>()) {}
     SnapshotIsolationLattice(const SnapshotIsolationPayload<T> &p) :
-      Lattice<SnapshotIsolationPayload<T>>(p) {}
+      Base(p) {}
+    SnapshotIsolationLattice(SnapshotIsolationPayload<T> &&p) :
+      Base(std::move(p)) {}
   MaxLattice<unsigned> size() { return {this->element.size()}; }
 };
 
 template <typename K, typename V>
-class MapSILattice : public Lattice<std::map<K, V, std::greater<K>>> {
+class MapSILattice
+    : public Lattice<std::map<K, V, std::greater<K>>, MapSILattice<K, V>> {
+    using Base = Lattice<std::map<K, V, std::greater<K>>, MapSILattice<K, V>>;
+    friend Base;
+
 protected:
     void insert_pair(const K &k, const V &v) {
         auto search = this->element.find(k);
@@ -81,8 +98,7 @@ protected:
             static_cast<V *>(&(search->second))->merge(v);
         } else {
             // need to copy v since we will be "growing" it within the lattice
-            V new_v = v;
-            this->element.emplace(k, new_v);
+            this->element.emplace(k, v);
         }
     }
 
@@ -93,8 +109,8 @@ protected:
     }
 
 public:
-    MapSILattice() : Lattice<std::map<K, V, std::greater<K>>>(std::map<K, V, std::greater<K>>()) {}
-    MapSILattice(const std::map<K, V, std::greater<K>> &m) : Lattice<std::map<K, V, std::greater<K>>>(m) {}
+    MapSILattice() : Base(std::map<K, V, std::greater<K>>()) {}
+    MapSILattice(const std::map<K, V, std::greater<K>> &m) : Base(m) {}
     MaxLattice<unsigned> size() const { return this->element.size(); }
 
     MapSILattice<K, V> intersect(MapSILattice<K, V> other) const {
@@ -0,0 +1,132 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_LATTICES_VECTOR_CLOCK_HPP_
+#define INCLUDE_LATTICES_VECTOR_CLOCK_HPP_
+
+#include "core_lattices.hpp"
+
+using VectorClock = MapLattice<string, MaxLattice<unsigned>>;
+
+// How two vector clocks, and so the versions they stamp, are ordered.
+enum class ClockOrder {
+  // the first clock happened before the second
+  LESS,
+  // the second clock happened before the first
+  GREATER,
+  EQUAL,
+  // each clock has seen an event the other has not
+  CONCURRENT,
+};
+
+// Builds the order from whether the first clock is ahead of the second for
+// some node and whether it is behind it for some node.
+inline ClockOrder to_clock_order(bool ahead, bool behind) {
+  if (ahead) {
+    return behind ? ClockOrder::CONCURRENT : ClockOrder::GREATER;
+  }
+
+  return behind ? ClockOrder::LESS : ClockOrder::EQUAL;
+}
+
+/**
+ * Orders a against b without building any temporary clocks. Nodes missing
+ * from a clock count as 0. b is only walked a second time if it has nodes
+ * that a lacks. Unless the clocks are concurrent, shared_nodes (if given) is
+ * set to the number of nodes with an entry in both clocks.
+ */
+inline ClockOrder compare(const VectorClock &a, const VectorClock &b,
+                          size_t *shared_nodes = nullptr) {
+  bool ahead = false, behind = false;
+  size_t shared = 0;
+
+  for (const auto &pair : a.reveal()) {
+    auto it = b.reveal().find(pair.first);
+    unsigned theirs = 0;
+
+    if (it != b.reveal().end()) {
+      theirs = it->second.reveal();
+      shared++;
+    }
+
+    ahead |= pair.second.reveal() > theirs;
+    behind |= pair.second.reveal() < theirs;
+
+    if (ahead && behind) {
+      return ClockOrder::CONCURRENT;
+    }
+  }
+
+  if (shared_nodes != nullptr) {
+    *shared_nodes = shared;
+  }
+
+  if (!behind && shared < b.reveal().size()) {
+    for (const auto &pair : b.reveal()) {
+      if (pair.second.reveal() > 0 &&
+          a.reveal().find(pair.first) == a.reveal().end()) {
+        behind = true;
+        break;
+      }
+    }
+  }
+
+  return to_clock_order(ahead, behind);
+}
+
+// What a causal lattice does with an incoming version.
+enum class CausalMerge {
+  // the incoming version replaces the local one
+  ASSIGN,
+  // the local version is kept as is
+  KEEP,
+  // the two versions are merged
+  MERGE,
+};
+
+/**
+ * Decides how to merge a version stamped incoming into one stamped local.
+ * This is the outcome of merging the clocks and comparing the result with
+ * both of them, entry for entry: explicit 0 entries count, so a clock with an
+ * entry the other lacks is never replaced by or kept over it unmerged.
+ */
+inline CausalMerge causal_merge(const VectorClock &local,
+                                const VectorClock &incoming) {
+  size_t shared;
+  switch (compare(local, incoming, &shared)) {
+    case ClockOrder::LESS:
+      if (shared == local.reveal().size()) {
+        return CausalMerge::ASSIGN;
+      }
+      break;
+    case ClockOrder::EQUAL:
+      if (shared == local.reveal().size()) {
+        return CausalMerge::ASSIGN;
+      } else if (shared == incoming.reveal().size()) {
+        return CausalMerge::KEEP;
+      }
+      break;
+    case ClockOrder::GREATER:
+      if (shared == incoming.reveal().size()) {
+        return CausalMerge::KEEP;
+      }
+      break;
+    case ClockOrder::CONCURRENT:
+      break;
+  }
+
+  return CausalMerge::MERGE;
+}
+
+#endif  // INCLUDE_LATTICES_VECTOR_CLOCK_HPP_
@@ -0,0 +1,84 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_MPSC_QUEUE_HPP_
+#define INCLUDE_MPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <utility>
+
+// An unbounded, lock-free multi-producer single-consumer queue (after Dmitry
+// Vyukov's intrusive MPSC node queue). Any number of threads may call push
+// concurrently; only one thread at a time may call pop. A push is a single
+// atomic exchange, so producers never wait on each other or on the consumer.
+//
+// A pop that races with an in-flight push may briefly see the queue as empty
+// even though the push has started; the element becomes visible as soon as
+// that push returns.
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() : head_(new Node()), tail_(head_.load()) {}
+
+  ~MpscQueue() {
+    T value;
+    while (pop(&value)) {
+    }
+
+    delete tail_;
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  void push(T value) {
+    Node* node = new Node(std::move(value));
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // Moves the oldest element into `value`. Returns false if the queue is
+  // empty. Must only be called from the consumer thread.
+  bool pop(T* value) {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+
+    if (next == nullptr) {
+      return false;
+    }
+
+    // `next` becomes the new stub node once its value has been taken
+    *value = std::move(next->value);
+    tail_ = next;
+    delete tail;
+    return true;
+  }
+
+ private:
+  struct Node {
+    Node() : next(nullptr) {}
+    explicit Node(T v) : next(nullptr), value(std::move(v)) {}
+
+    std::atomic<Node*> next;
+    T value;
+  };
+
+  // producers append here
+  std::atomic<Node*> head_;
+
+  // the consumer removes from here; always points at a stub node
+  Node* tail_;
+};
+
+#endif  // INCLUDE_MPSC_QUEUE_HPP_
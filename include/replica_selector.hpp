@@ -0,0 +1,309 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef INCLUDE_REPLICA_SELECTOR_HPP_
+#define INCLUDE_REPLICA_SELECTOR_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+#include "deadline_queue.hpp"
+#include "types.hpp"
+
+// The number of recent response latencies kept to estimate percentiles.
+const unsigned kLatencyWindowSize = 256;
+
+// How long it takes the penalty for a timeout to halve by default.
+const std::chrono::milliseconds kTimeoutPenaltyHalfLife(1000);
+
+// How a client picks one of the replicas responsible for a key.
+enum class ReplicaPolicy {
+  // uniformly at random
+  RANDOM,
+  // the cheaper of two replicas picked at random
+  POWER_OF_TWO_CHOICES,
+  // the cheapest replica
+  LEAST_LOADED,
+};
+
+// What a client knows about one storage thread.
+struct WorkerStats {
+  // the exponentially weighted moving average of its response latency, in us
+  double latency_ewma_ = 0;
+
+  // requests sent to it that have neither been answered nor timed out
+  unsigned outstanding_ = 0;
+
+  // whether latency_ewma_ holds a measurement yet
+  bool sampled_ = false;
+
+  // the latency in us charged for its last timeout, as of penalized_at_; it
+  // decays from then on, and is dropped when it answers a request
+  double timeout_penalty_ = 0;
+  Deadline penalized_at_;
+};
+
+// A ReplicaSelector tracks the latency and load of every storage thread a
+// client talks to, and uses them to pick among a key's replicas. A replica's
+// cost is its latency EWMA times one more than its outstanding requests, so a
+// slow or backed-up thread is avoided until it recovers; threads that have not
+// been measured yet cost only their outstanding requests, so they get probed.
+// A timeout adds a penalty of the whole timeout to a thread's latency. The
+// penalty halves every penalty_half_life, so a thread that timed out is
+// avoided at first but tried again once the penalty has decayed, rather than
+// shunned for good. The selector also keeps a window of recent latencies
+// across all threads, from which the clients derive the delay before hedging
+// a read.
+class ReplicaSelector {
+ public:
+  /**
+   * @policy How replicas are picked
+   * @alpha The weight of a new sample in the latency EWMA
+   * @penalty_half_life How long it takes the penalty for a timeout to halve
+   */
+  explicit ReplicaSelector(
+      ReplicaPolicy policy = ReplicaPolicy::POWER_OF_TWO_CHOICES,
+      double alpha = 0.2,
+      std::chrono::milliseconds penalty_half_life = kTimeoutPenaltyHalfLife) :
+      policy_(policy),
+      alpha_(alpha),
+      penalty_half_life_us_(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              penalty_half_life)
+              .count()),
+      next_sample_(0),
+      percentile_stale_(true),
+      cached_percentile_(0),
+      cached_q_(0) {}
+
+  /**
+   * Picks one of replicas other than exclude, using seed for randomness.
+   * Returns the empty string if there is no such replica.
+   */
+  Address select(const set<Address>& replicas, unsigned* seed,
+                 const Address& exclude = "") const {
+    unsigned candidates = replicas.size();
+    if (!exclude.empty() && replicas.find(exclude) != replicas.end()) {
+      candidates--;
+    }
+
+    if (candidates == 0) {
+      return "";
+    }
+
+    if (policy_ == ReplicaPolicy::LEAST_LOADED) {
+      const Address* best = nullptr;
+      double best_cost = 0;
+
+      for (const Address& replica : replicas) {
+        if (replica == exclude) {
+          continue;
+        }
+
+        double replica_cost = cost(replica);
+        if (best == nullptr || replica_cost < best_cost) {
+          best = &replica;
+          best_cost = replica_cost;
+        }
+      }
+
+      return *best;
+    }
+
+    unsigned first = rand_r(seed) % candidates;
+    if (policy_ == ReplicaPolicy::RANDOM || candidates == 1) {
+      return nth(replicas, first, exclude);
+    }
+
+    // draw a second, distinct index and look both up in one pass, since the
+    // set only has forward iterators
+    unsigned second = rand_r(seed) % (candidates - 1);
+    if (second >= first) {
+      second++;
+    }
+
+    const Address* a = nullptr;
+    const Address* b = nullptr;
+    unsigned index = 0;
+
+    for (const Address& replica : replicas) {
+      if (replica == exclude) {
+        continue;
+      }
+
+      if (index == first) {
+        a = &replica;
+      } else if (index == second) {
+        b = &replica;
+      }
+
+      if (a != nullptr && b != nullptr) {
+        break;
+      }
+      index++;
+    }
+
+    return cost(*b) < cost(*a) ? *b : *a;
+  }
+
+  /**
+   * Records that a request was sent to worker.
+   */
+  void on_send(const Address& worker) { stats_[worker].outstanding_++; }
+
+  /**
+   * Records that worker answered a request after latency.
+   */
+  void on_response(const Address& worker, std::chrono::microseconds latency) {
+    WorkerStats& stats = settle(worker);
+    double sample = latency.count();
+    stats.timeout_penalty_ = 0;
+
+    if (stats.sampled_) {
+      stats.latency_ewma_ += alpha_ * (sample - stats.latency_ewma_);
+    } else {
+      stats.latency_ewma_ = sample;
+      stats.sampled_ = true;
+    }
+
+    if (samples_.size() < kLatencyWindowSize) {
+      samples_.push_back(latency.count());
+    } else {
+      samples_[next_sample_] = latency.count();
+      next_sample_ = (next_sample_ + 1) % kLatencyWindowSize;
+    }
+    percentile_stale_ = true;
+  }
+
+  /**
+   * Records that a request to worker timed out after timeout. The worker is
+   * charged a penalty of timeout, which decays over time, so it is avoided for
+   * a while.
+   */
+  void on_timeout(const Address& worker, std::chrono::microseconds timeout) {
+    WorkerStats& stats = settle(worker);
+    stats.timeout_penalty_ = timeout.count();
+    stats.penalized_at_ = SteadyClock::now();
+  }
+
+  /**
+   * Records that a request to worker is no longer outstanding without
+   * measuring it, e.g. because another replica answered first.
+   */
+  void on_abandon(const Address& worker) { settle(worker); }
+
+  /**
+   * Returns the stats for worker, or nullptr if nothing was sent to it.
+   */
+  const WorkerStats* stats(const Address& worker) const {
+    auto it = stats_.find(worker);
+    return it == stats_.end() ? nullptr : &it->second;
+  }
+
+  /**
+   * Returns the q-th quantile (0 < q <= 1) of the recent response latencies,
+   * or 0 if there are none.
+   */
+  std::chrono::microseconds latency_percentile(double q) {
+    if (samples_.empty()) {
+      return std::chrono::microseconds(0);
+    }
+
+    if (percentile_stale_ || q != cached_q_) {
+      vector<int64_t> sorted = samples_;
+      unsigned rank = std::min<unsigned>(q * sorted.size(), sorted.size() - 1);
+      std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+
+      cached_percentile_ = sorted[rank];
+      cached_q_ = q;
+      percentile_stale_ = false;
+    }
+
+    return std::chrono::microseconds(cached_percentile_);
+  }
+
+  // The number of latencies the percentiles are computed from.
+  unsigned sample_count() const { return samples_.size(); }
+
+  ReplicaPolicy policy() const { return policy_; }
+
+  void set_policy(ReplicaPolicy policy) { policy_ = policy; }
+
+ private:
+  double cost(const Address& worker) const {
+    auto it = stats_.find(worker);
+    if (it == stats_.end()) {
+      return 0;
+    }
+
+    const WorkerStats& stats = it->second;
+    return (stats.latency_ewma_ + penalty(stats) + 1) *
+           (stats.outstanding_ + 1);
+  }
+
+  // The part of the worker's timeout penalty that has not decayed yet.
+  double penalty(const WorkerStats& stats) const {
+    if (stats.timeout_penalty_ == 0) {
+      return 0;
+    }
+
+    double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                         SteadyClock::now() - stats.penalized_at_)
+                         .count();
+    return stats.timeout_penalty_ *
+           std::exp2(-elapsed / std::max(penalty_half_life_us_, 1.0));
+  }
+
+  // Returns the index-th element of replicas, skipping exclude.
+  static const Address& nth(const set<Address>& replicas, unsigned index,
+                            const Address& exclude) {
+    auto it = replicas.begin();
+    while (true) {
+      if (*it != exclude) {
+        if (index == 0) {
+          return *it;
+        }
+        index--;
+      }
+      ++it;
+    }
+  }
+
+  WorkerStats& settle(const Address& worker) {
+    WorkerStats& stats = stats_[worker];
+    if (stats.outstanding_ > 0) {
+      stats.outstanding_--;
+    }
+    return stats;
+  }
+
+  ReplicaPolicy policy_;
+  double alpha_;
+  double penalty_half_life_us_;
+
+  flat_map<Address, WorkerStats> stats_;
+
+  // the recent latencies in us, as a ring buffer once full
+  vector<int64_t> samples_;
+  unsigned next_sample_;
+
+  // the last computed percentile, valid until the next sample arrives
+  bool percentile_stale_;
+  int64_t cached_percentile_;
+  double cached_q_;
+};
+
+#endif  // INCLUDE_REPLICA_SELECTOR_HPP_
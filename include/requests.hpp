@@ -15,29 +15,47 @@
 #ifndef INCLUDE_REQUESTS_HPP_
 #define INCLUDE_REQUESTS_HPP_
 
+#include "deadline_queue.hpp"
 #include "zmq/socket_cache.hpp"
 #include "zmq/zmq_util.hpp"
 
+// Serializes a protobuf straight into the buffer of a new ZMQ message, rather
+// than into a string that then has to be copied into a message.
+template <typename MSG>
+zmq::message_t serialize_to_message(const MSG& msg) {
+  zmq::message_t message(msg.ByteSizeLong());
+  msg.SerializeWithCachedSizesToArray(static_cast<uint8_t*>(message.data()));
+  return message;
+}
+
+// Parses a protobuf straight out of the buffer of a ZMQ message.
+template <typename MSG>
+bool parse_from_message(const zmq::message_t& message, MSG* msg) {
+  return msg->ParseFromArray(message.data(), message.size());
+}
+
 template <typename RES>
 bool receive(zmq::socket_t& recv_socket, set<string>& request_ids,
              vector<RES>& responses) {
   zmq::message_t message;
 
+  // Every message is parsed into the same response, so parsing a response we
+  // are not waiting for reuses the buffers of the previous one; the ones we
+  // are waiting for are moved into responses.
+  RES response;
+
   // We allow as many timeouts as there are requests that we made. We may want
   // to make this configurable at some point.
   unsigned timeout_limit = request_ids.size();
 
   while (true) {
-    RES response;
-
     if (recv_socket.recv(&message)) {
-      string serialized_resp = kZmqUtil->message_to_string(message);
-      response.ParseFromString(serialized_resp);
-      string resp_id = response.response_id();
+      parse_from_message(message, &response);
+      auto it = request_ids.find(response.response_id());
 
-      if (request_ids.find(resp_id) != request_ids.end()) {
-        request_ids.erase(resp_id);
-        responses.push_back(response);
+      if (it != request_ids.end()) {
+        request_ids.erase(it);
+        responses.push_back(std::move(response));
       }
 
       if (request_ids.size() == 0) {
@@ -57,11 +75,91 @@ bool receive(zmq::socket_t& recv_socket, set<string>& request_ids,
   }
 }
 
+// What gather collected: the responses that arrived in time, in arrival
+// order, and the IDs of the requests that got none.
+template <typename RES>
+struct GatherResult {
+  vector<RES> responses;
+  vector<string> timed_out;
+
+  bool complete() const { return timed_out.empty(); }
+};
+
+/**
+ * Collects the responses to request_ids from recv_socket until all of them
+ * have arrived or deadline passes, whichever comes first, and returns what
+ * arrived. Unlike receive, the wait is bounded by deadline no matter how many
+ * requests there are, and a late response only affects its own request.
+ * Responses to other requests are dropped.
+ *
+ * Each message is parsed straight into the next slot of the result; the slot
+ * is reused if the message turns out to answer some other request.
+ */
+template <typename RES>
+GatherResult<RES> gather(zmq::socket_t& recv_socket,
+                         const set<string>& request_ids, Deadline deadline) {
+  GatherResult<RES> result;
+  result.responses.reserve(request_ids.size());
+
+  set<string> outstanding = request_ids;
+  vector<zmq::pollitem_t> items = {
+      {static_cast<void*>(recv_socket), 0, ZMQ_POLLIN, 0}};
+  zmq::message_t message;
+
+  // whether the last slot of responses holds a response we did not want
+  bool spare = false;
+
+  while (!outstanding.empty()) {
+    if (!kZmqUtil->try_recv_message(&recv_socket, &message)) {
+      Deadline now = SteadyClock::now();
+      if (now >= deadline) {
+        break;
+      }
+
+      // round up, so that the poll does not return just before the deadline
+      auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - now + std::chrono::milliseconds(1) -
+          std::chrono::nanoseconds(1));
+      kZmqUtil->poll(wait.count(), &items);
+      continue;
+    }
+
+    if (!spare) {
+      result.responses.emplace_back();
+    }
+
+    RES& response = result.responses.back();
+    auto it = outstanding.end();
+    if (parse_from_message(message, &response)) {
+      it = outstanding.find(response.response_id());
+    }
+
+    if (it == outstanding.end()) {
+      spare = true;
+
+      // a stream of unrelated responses must not hold us past the deadline
+      if (SteadyClock::now() >= deadline) {
+        break;
+      }
+      continue;
+    }
+
+    outstanding.erase(it);
+    spare = false;
+  }
+
+  if (spare) {
+    result.responses.pop_back();
+  }
+
+  result.timed_out.assign(outstanding.begin(), outstanding.end());
+  return result;
+}
+
 template <typename REQ>
 void send_request(const REQ& request, zmq::socket_t& send_socket) {
-  string serialized_req;
-  request.SerializeToString(&serialized_req);
-  kZmqUtil->send_string(serialized_req, &send_socket);
+  zmq::message_t message = serialize_to_message(request);
+  kZmqUtil->send_message(message, &send_socket);
 }
 
 // Synchronous combination of send and receive.
@@ -75,10 +173,67 @@ RES make_request(const REQ& request, zmq::socket_t& send_socket,
   succeed = receive<RES>(recv_socket, req_ids, responses);
 
   if (succeed) {
-    return responses[0];
+    return std::move(responses[0]);
   } else {
     return RES();
   }
 }
 
+/**
+ * Pipelined make_request: sends requests in order over send_socket, keeping
+ * up to window of them unanswered at a time, and calls on_response with each
+ * response from recv_socket as it arrives, so responses come in completion
+ * order rather than request order. A request that is not answered within
+ * timeout of being sent is given up on, which frees its slot in the window.
+ * Returns the IDs of the requests that were given up on.
+ *
+ * Request IDs must be unique within requests. on_response takes a RES& and
+ * may move out of it; responses to other requests are dropped.
+ */
+template <typename REQ, typename RES, typename F>
+vector<string> make_requests(const vector<REQ>& requests,
+                             zmq::socket_t& send_socket,
+                             zmq::socket_t& recv_socket, unsigned window,
+                             std::chrono::milliseconds timeout,
+                             F on_response) {
+  // the IDs of the requests in flight, each with the time it is given up at
+  DeadlineQueue<string> in_flight;
+  vector<string> timed_out;
+  unsigned next = 0;
+
+  vector<zmq::pollitem_t> items = {
+      {static_cast<void*>(recv_socket), 0, ZMQ_POLLIN, 0}};
+  zmq::message_t message;
+  RES response;
+
+  if (window == 0) {
+    window = 1;
+  }
+
+  while (next < requests.size() || !in_flight.empty()) {
+    Deadline now = SteadyClock::now();
+    for (string& id : in_flight.expire(now)) {
+      timed_out.push_back(std::move(id));
+    }
+
+    while (next < requests.size() && in_flight.size() < window) {
+      const REQ& request = requests[next++];
+      send_request<REQ>(request, send_socket);
+      in_flight.schedule(request.request_id(), now + timeout);
+    }
+
+    if (kZmqUtil->try_recv_message(&recv_socket, &message)) {
+      if (parse_from_message(message, &response) &&
+          in_flight.contains(response.response_id())) {
+        in_flight.cancel(response.response_id());
+        on_response(response);
+      }
+    } else if (!in_flight.empty()) {
+      kZmqUtil->poll(in_flight.cap_wait(now, timeout).count(), &items);
+    }
+  }
+
+  return timed_out;
+}
+
 #endif  // INCLUDE_REQUESTS_HPP_
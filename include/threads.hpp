@@ -17,6 +17,9 @@
 
 #include "types.hpp"
 
+// The port on which storage server threads receive key requests.
+const unsigned kKeyRequestPort = 6200;
+
 // The port on which clients send key address requests to routing nodes.
 const unsigned kKeyAddressPort = 6450;
 
@@ -55,6 +58,43 @@ const unsigned clientCommitPort = 7550;
 
 const string kBindBase = "tcp://*:";
 
+// A storage server thread, named the way the servers' hash rings name it.
+class ServerThread {
+  Address public_ip_;
+  Address private_ip_;
+  Address public_base_;
+  unsigned tid_;
+  unsigned virtual_num_;
+
+ public:
+  ServerThread() {}
+  ServerThread(Address public_ip, Address private_ip, unsigned tid,
+               unsigned virtual_num = 0) :
+      public_ip_(public_ip),
+      private_ip_(private_ip),
+      public_base_("tcp://" + public_ip_ + ":"),
+      tid_(tid),
+      virtual_num_(virtual_num) {}
+
+  Address public_ip() const { return public_ip_; }
+
+  Address private_ip() const { return private_ip_; }
+
+  unsigned tid() const { return tid_; }
+
+  unsigned virtual_num() const { return virtual_num_; }
+
+  string id() const { return private_ip_ + ":" + std::to_string(tid_); }
+
+  string virtual_id() const {
+    return id() + "_" + std::to_string(virtual_num_);
+  }
+
+  Address key_request_connect_address() const {
+    return public_base_ + std::to_string(tid_ + kKeyRequestPort);
+  }
+};
+
 class CacheThread {
   Address ip_;
   Address ip_base_;
@@ -15,11 +15,13 @@
 #ifndef INCLUDE_TYPES_HPP_
 #define INCLUDE_TYPES_HPP_
 
+#include <cstdint>
 #include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
+#include "flat_hash_map.hpp"
 #include "spdlog/spdlog.h"
 
 using string = std::string;
@@ -30,6 +32,11 @@ using map = std::unordered_map<K, V>;
 template <class K, class V, class H>
 using hmap = std::unordered_map<K, V, H>;
 
+// An open-addressing alternative to map for hot tables; unlike map, inserting
+// into it invalidates references to its entries.
+template <class K, class V, class H = std::hash<K>>
+using flat_map = FlatHashMap<K, V, H>;
+
 template <class T>
 using ordered_set = std::set<T>;
 
@@ -46,6 +53,19 @@ using Address = std::string;
 
 using Key = std::string;
 
+// A client-assigned request ID; see make_request_id in common.hpp.
+using RequestId = uint64_t;
+
 using logger = std::shared_ptr<spdlog::logger>;
 
+// A hash for using pairs (e.g., a key and a request ID) as hash map keys.
+struct pair_hash {
+  template <class F, class S>
+  std::size_t operator()(const pair<F, S>& p) const {
+    std::size_t seed = std::hash<F>()(p.first);
+    return seed ^ (std::hash<S>()(p.second) + 0x9e3779b9 + (seed << 6) +
+                   (seed >> 2));
+  }
+};
+
 #endif  // INCLUDE_TYPES_HPP_
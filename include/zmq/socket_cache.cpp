@@ -17,18 +17,86 @@
 #include <utility>
 
 zmq::socket_t& SocketCache::At(const Address& addr) {
-  auto iter = cache_.find(addr);
-  if (iter != cache_.end()) {
-    return iter->second;
+  auto iter = index_.find(addr);
+  if (iter != index_.end()) {
+    // move the socket to the front of the LRU list
+    sockets_.splice(sockets_.begin(), sockets_, iter->second);
+    iter->second->stats_.sends_++;
+    return iter->second->socket_;
+  }
+
+  while (index_.size() >= capacity_) {
+    evict();
   }
 
   zmq::socket_t socket(*context_, type_);
+  for (const auto& option : options_) {
+    socket.setsockopt(option.first, option.second);
+  }
   socket.connect(addr);
-  auto p = cache_.insert(std::make_pair(addr, std::move(socket)));
 
-  return p.first->second;
+  sockets_.push_front(Entry{addr, std::move(socket), SocketStats()});
+  sockets_.front().stats_.sends_++;
+  index_[addr] = sockets_.begin();
+
+  return sockets_.front().socket_;
 }
 
 zmq::socket_t& SocketCache::operator[](const Address& addr) { return At(addr); }
 
-void SocketCache::clear_cache() { cache_.clear(); }
+void SocketCache::clear_cache() {
+  index_.clear();
+  sockets_.clear();
+}
+
+void SocketCache::set_option(int option, int value) {
+  bool replaced = false;
+  for (auto& existing : options_) {
+    if (existing.first == option) {
+      existing.second = value;
+      replaced = true;
+    }
+  }
+
+  if (!replaced) {
+    options_.push_back(std::make_pair(option, value));
+  }
+
+  for (Entry& entry : sockets_) {
+    entry.socket_.setsockopt(option, value);
+  }
+}
+
+void SocketCache::set_capacity(unsigned capacity) {
+  capacity_ = capacity == 0 ? 1 : capacity;
+
+  while (index_.size() > capacity_) {
+    evict();
+  }
+}
+
+SocketStats SocketCache::stats(const Address& addr) const {
+  auto iter = index_.find(addr);
+  return iter == index_.end() ? SocketStats() : iter->second->stats_;
+}
+
+map<Address, SocketStats> SocketCache::all_stats() const {
+  map<Address, SocketStats> result;
+  for (const Entry& entry : sockets_) {
+    result.emplace(entry.addr_, entry.stats_);
+  }
+
+  return result;
+}
+
+void SocketCache::reset_stats() {
+  for (Entry& entry : sockets_) {
+    entry.stats_ = SocketStats();
+  }
+}
+
+void SocketCache::evict() {
+  index_.erase(sockets_.back().addr_);
+  sockets_.pop_back();
+  evictions_++;
+}
@@ -15,12 +15,25 @@
 #ifndef SRC_INCLUDE_ZMQ_SOCKET_CACHE_HPP_
 #define SRC_INCLUDE_ZMQ_SOCKET_CACHE_HPP_
 
-#include <map>
+#include <cstdint>
+#include <list>
 #include <string>
 
 #include "types.hpp"
 #include "zmq.hpp"
 
+// The default bound on the number of sockets a SocketCache keeps open.
+const unsigned kMaxSocketNumber = 10000;
+
+// What a SocketCache knows about the socket for one address. The counters
+// cover the socket's time in the cache; they are dropped with the socket when
+// it is evicted, so a client that talks to many addresses in turn does not
+// accumulate them.
+struct SocketStats {
+  // the number of times the socket was looked up to send on it
+  uint64_t sends_ = 0;
+};
+
 // A SocketCache is a map from ZeroMQ addresses to PUSH ZeroMQ sockets. The
 // socket corresponding to address `address` can be retrieved from a
 // SocketCache `cache` with `cache[address]` or `cache.At(address)`. If a
@@ -37,19 +50,79 @@
 //   zmq::socket_t& the_same_a_as_before = cache["inproc://a"];
 //   // cache.At("inproc://a") is 100% equivalent to cache["inproc://a"].
 //   zmq::socket_t& another_a = cache.At("inproc://a");
+//
+// The cache holds at most `capacity` sockets. Creating one more closes the
+// least recently used socket, so a returned reference is only valid until a
+// socket for another address is requested; callers are expected to send on
+// it right away. Socket options set on the cache, such as the send high-water
+// mark, apply to every socket it holds. Every lookup counts as a send to its
+// address, since sending is what the sockets are looked up for.
 class SocketCache {
  public:
-  explicit SocketCache(zmq::context_t* context, int type) :
+  explicit SocketCache(zmq::context_t* context, int type,
+                       unsigned capacity = kMaxSocketNumber) :
       context_(context),
-      type_(type) {}
+      type_(type),
+      capacity_(capacity == 0 ? 1 : capacity),
+      evictions_(0) {}
   zmq::socket_t& At(const Address& addr);
   zmq::socket_t& operator[](const Address& addr);
   void clear_cache();
 
+  // Sets an integer socket option on every cached socket and every socket
+  // created from now on.
+  void set_option(int option, int value);
+
+  // The number of messages queued per socket before sends block or drop.
+  void set_send_hwm(int hwm) { set_option(ZMQ_SNDHWM, hwm); }
+
+  // How long in ms a closed socket keeps trying to deliver queued messages.
+  void set_linger(int linger) { set_option(ZMQ_LINGER, linger); }
+
+  // The kernel send buffer size in bytes of each socket.
+  void set_send_buffer(int bytes) { set_option(ZMQ_SNDBUF, bytes); }
+
+  // Lowering the capacity closes the least recently used sockets right away.
+  void set_capacity(unsigned capacity);
+
+  unsigned size() const { return index_.size(); }
+
+  unsigned capacity() const { return capacity_; }
+
+  // sockets closed to make room for new ones
+  uint64_t evictions() const { return evictions_; }
+
+  // Returns the counters for addr, or zeroes if it has no open socket.
+  SocketStats stats(const Address& addr) const;
+
+  // Returns the counters of every open socket.
+  map<Address, SocketStats> all_stats() const;
+
+  // Zeroes the counters of every open socket, e.g., at the start of a
+  // reporting period; evictions() is left as it is.
+  void reset_stats();
+
  private:
+  struct Entry {
+    Address addr_;
+    zmq::socket_t socket_;
+    SocketStats stats_;
+  };
+
+  void evict();
+
   zmq::context_t* context_;
-  std::map<Address, zmq::socket_t> cache_;
   int type_;
+  unsigned capacity_;
+
+  // the open sockets, most recently used first, and where each address is
+  std::list<Entry> sockets_;
+  map<Address, std::list<Entry>::iterator> index_;
+
+  // the options applied to every socket, in the order they were set
+  vector<pair<int, int>> options_;
+
+  uint64_t evictions_;
 };
 
 #endif  // SRC_INCLUDE_ZMQ_SOCKET_CACHE_HPP_
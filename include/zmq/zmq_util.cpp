@@ -37,6 +37,15 @@ string ZmqUtil::recv_string(zmq::socket_t* socket) {
   return message_to_string(message);
 }
 
+void ZmqUtil::send_message(zmq::message_t& message, zmq::socket_t* socket) {
+  socket->send(message);
+}
+
+bool ZmqUtil::try_recv_message(zmq::socket_t* socket,
+                               zmq::message_t* message) {
+  return socket->recv(message, ZMQ_DONTWAIT);
+}
+
 int ZmqUtil::poll(long timeout, vector<zmq::pollitem_t>* items) {
   return zmq::poll(items->data(), items->size(), timeout);
 }
@@ -34,6 +34,13 @@ class ZmqUtilInterface {
   virtual void send_string(const string& s, zmq::socket_t* socket) = 0;
   // `recv` a string over the socket.
   virtual string recv_string(zmq::socket_t* socket) = 0;
+  // `send` a message over the socket without copying its contents; the
+  // message is empty afterwards.
+  virtual void send_message(zmq::message_t& message, zmq::socket_t* socket) = 0;
+  // `recv` a message over the socket without blocking or copying its
+  // contents. Returns false if no message was queued.
+  virtual bool try_recv_message(zmq::socket_t* socket,
+                                zmq::message_t* message) = 0;
   // `poll` is a wrapper around `zmq::poll` that takes a vector instead of a
   // pointer and a size.
   virtual int poll(long timeout, vector<zmq::pollitem_t>* items) = 0;
@@ -43,6 +50,9 @@ class ZmqUtil : public ZmqUtilInterface {
  public:
   virtual void send_string(const string& s, zmq::socket_t* socket);
   virtual string recv_string(zmq::socket_t* socket);
+  virtual void send_message(zmq::message_t& message, zmq::socket_t* socket);
+  virtual bool try_recv_message(zmq::socket_t* socket,
+                                zmq::message_t* message);
   virtual int poll(long timeout, vector<zmq::pollitem_t>* items);
 };
 
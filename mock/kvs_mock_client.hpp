@@ -41,7 +41,15 @@ class KvsMockClient : public KvsClientInterface {
   string put_async(const Key& key, const string& payload,
                    LatticeType lattice_type) {
     keys_put_.push_back(key);
-    return get_request_id();
+    return legacy_request_id(get_request_id());
+  }
+
+  string put_async(const Key& key, const string& payload,
+                   LatticeType lattice_type, ResponseCallback callback) {
+    keys_put_.push_back(key);
+    RequestId request_id = get_request_id();
+    put_callbacks_[std::make_pair(key, request_id)] = std::move(callback);
+    return legacy_request_id(request_id);
   }
 
   /**
@@ -49,7 +57,33 @@ class KvsMockClient : public KvsClientInterface {
    */
   void get_async(const Key& key) { keys_get_.push_back(key); }
 
-  vector<KeyResponse> receive_async() { return responses_; }
+  void get_async(const Key& key, ResponseCallback callback) {
+    get_callbacks_[key].push_back(std::move(callback));
+    get_async(key);
+  }
+
+  /**
+   * Issue async PUT requests for a batch of keys.
+   */
+  string put_batch_async(const vector<Key>& keys,
+                         const vector<string>& payloads,
+                         LatticeType lattice_type) {
+    keys_put_.insert(keys_put_.end(), keys.begin(), keys.end());
+    return legacy_request_id(get_request_id());
+  }
+
+  /**
+   * Issue async GET requests for a batch of keys.
+   */
+  void get_batch_async(const vector<Key>& keys) {
+    keys_get_.insert(keys_get_.end(), keys.begin(), keys.end());
+  }
+
+  vector<KeyResponse> receive_async() { return dispatch_callbacks(); }
+
+  vector<KeyResponse> receive(std::chrono::milliseconds max_wait) {
+    return dispatch_callbacks();
+  }
 
   zmq::context_t* get_context() { return nullptr; }
 
@@ -57,6 +91,8 @@ class KvsMockClient : public KvsClientInterface {
     keys_put_.clear();
     keys_get_.clear();
     responses_.clear();
+    get_callbacks_.clear();
+    put_callbacks_.clear();
   }
 
   // keep track of the keys being put
@@ -70,13 +106,56 @@ class KvsMockClient : public KvsClientInterface {
   /**
    * Generates a unique request ID.
    */
-  string get_request_id() {
-    if (++rid_ % 10000 == 0) rid_ = 0;
-    return std::to_string(rid_++);
+  RequestId get_request_id() { return rid_++; }
+
+  /**
+   * Hands each canned response that has callbacks registered for it to those
+   * callbacks, as KvsClient does, and returns the remaining ones. Callbacks
+   * fire once; the canned responses are kept for later calls.
+   */
+  vector<KeyResponse> dispatch_callbacks() {
+    vector<KeyResponse> unclaimed;
+
+    for (KeyResponse response : responses_) {
+      restore_response_ids(&response);
+      Key key = response.tuples(0).key();
+      vector<ResponseCallback> callbacks;
+
+      if (response.type() == RequestType::GET) {
+        auto it = get_callbacks_.find(key);
+        if (it != get_callbacks_.end()) {
+          callbacks = std::move(it->second);
+          get_callbacks_.erase(it);
+        }
+      } else {
+        auto it =
+            put_callbacks_.find(std::make_pair(key, response.response_rid()));
+        if (it != put_callbacks_.end()) {
+          callbacks.push_back(std::move(it->second));
+          put_callbacks_.erase(it);
+        }
+      }
+
+      if (callbacks.empty()) {
+        unclaimed.push_back(response);
+      }
+
+      for (const ResponseCallback& callback : callbacks) {
+        callback(response);
+      }
+    }
+
+    return unclaimed;
   }
 
   // the current request id
-  unsigned rid_;
+  RequestId rid_;
+
+  // callbacks waiting on GET responses, by key
+  map<Key, vector<ResponseCallback>> get_callbacks_;
+
+  // callbacks waiting on PUT responses, by key and request ID
+  hmap<pair<Key, RequestId>, ResponseCallback, pair_hash> put_callbacks_;
 };
 
 #endif  // INCLUDE_CLIENT_KVS_MOCK_CLIENT_HPP_
@@ -20,6 +20,16 @@ void MockZmqUtil::send_string(const string &s, zmq::socket_t *socket) {
 
 string MockZmqUtil::recv_string(zmq::socket_t *socket) { return ""; }
 
+void MockZmqUtil::send_message(zmq::message_t &message,
+                               zmq::socket_t *socket) {
+  sent_messages.push_back(message_to_string(message));
+}
+
+bool MockZmqUtil::try_recv_message(zmq::socket_t *socket,
+                                   zmq::message_t *message) {
+  return false;
+}
+
 int MockZmqUtil::poll(long timeout, vector<zmq::pollitem_t> *items) {
   return 0;
 }
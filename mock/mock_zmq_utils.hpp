@@ -23,6 +23,9 @@ class MockZmqUtil : public ZmqUtilInterface {
 
   virtual void send_string(const string &s, zmq::socket_t *socket);
   virtual string recv_string(zmq::socket_t *socket);
+  virtual void send_message(zmq::message_t &message, zmq::socket_t *socket);
+  virtual bool try_recv_message(zmq::socket_t *socket,
+                                zmq::message_t *message);
   virtual int poll(long timeout, vector<zmq::pollitem_t> *items);
 };
 
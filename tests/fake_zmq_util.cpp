@@ -0,0 +1,67 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "fake_zmq_util.hpp"
+
+#include <algorithm>
+
+FakeZmqUtil kFakeZmqUtil;
+ZmqUtilInterface* kZmqUtil = &kFakeZmqUtil;
+
+void FakeZmqUtil::send_string(const string& s,
+                              zmq::socket_t* /*socket*/) {
+  sent_messages_.push_back(s);
+}
+
+string FakeZmqUtil::recv_string(zmq::socket_t* /*socket*/) { return ""; }
+
+void FakeZmqUtil::send_message(zmq::message_t& message,
+                               zmq::socket_t* /*socket*/) {
+  sent_messages_.push_back(message_to_string(message));
+}
+
+bool FakeZmqUtil::try_recv_message(zmq::socket_t* socket,
+                                   zmq::message_t* message) {
+  auto it = std::find(sockets_.begin(), sockets_.end(), socket);
+  unsigned index = it - sockets_.begin();
+  if (it == sockets_.end()) {
+    sockets_.push_back(socket);
+  }
+
+  std::deque<string>& queue = queued_[index];
+  if (queue.empty()) {
+    return false;
+  }
+
+  *message = string_to_message(queue.front());
+  queue.pop_front();
+  return true;
+}
+
+int FakeZmqUtil::poll(long /*timeout*/,
+                      vector<zmq::pollitem_t>* /*items*/) {
+  for (const auto& queue : queued_) {
+    if (!queue.second.empty()) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+void FakeZmqUtil::reset() {
+  sent_messages_.clear();
+  sockets_.clear();
+  queued_.clear();
+}
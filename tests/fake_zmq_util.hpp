@@ -0,0 +1,62 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#ifndef TESTS_FAKE_ZMQ_UTIL_HPP_
+#define TESTS_FAKE_ZMQ_UTIL_HPP_
+
+#include <deque>
+
+#include "zmq/zmq_util.hpp"
+
+// A FakeZmqUtil stands in for the ZMQ transport in client tests: messages a
+// client sends are recorded instead of being sent, and try_recv_message hands
+// out messages that the test queued. A client's receiving sockets are told
+// apart by the order in which it first receives on them; e.g., for a KvsClient
+// socket 0 is the key address puller and socket 1 the response puller.
+class FakeZmqUtil : public ZmqUtilInterface {
+ public:
+  void send_string(const string& s, zmq::socket_t* socket);
+  string recv_string(zmq::socket_t* socket);
+  void send_message(zmq::message_t& message, zmq::socket_t* socket);
+  bool try_recv_message(zmq::socket_t* socket, zmq::message_t* message);
+  int poll(long timeout, vector<zmq::pollitem_t>* items);
+
+  // Queues msg to be received on the socket-th receiving socket.
+  template <typename MSG>
+  void deliver(unsigned socket, const MSG& msg) {
+    queued_[socket].push_back(msg.SerializeAsString());
+  }
+
+  // Parses the index-th message sent since the last reset.
+  template <typename MSG>
+  MSG sent(unsigned index) const {
+    MSG msg;
+    msg.ParseFromString(sent_messages_.at(index));
+    return msg;
+  }
+
+  unsigned sent_count() const { return sent_messages_.size(); }
+
+  // Forgets all messages and sockets; call it before each new client.
+  void reset();
+
+ private:
+  vector<string> sent_messages_;
+  vector<zmq::socket_t*> sockets_;
+  map<unsigned, std::deque<string>> queued_;
+};
+
+extern FakeZmqUtil kFakeZmqUtil;
+
+#endif  // TESTS_FAKE_ZMQ_UTIL_HPP_
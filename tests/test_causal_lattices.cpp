@@ -0,0 +1,183 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <random>
+
+#include "gtest/gtest.h"
+#include "lattices/multi_key_causal_lattice.hpp"
+#include "lattices/single_key_causal_lattice.hpp"
+
+namespace {
+
+using Strings = SetLattice<string>;
+using SingleKey = SingleKeyCausalLattice<Strings>;
+using MultiKey = MultiKeyCausalLattice<Strings>;
+using Dependencies = MapLattice<Key, VectorClock>;
+
+VectorClock clock(const map<string, unsigned>& entries) {
+  VectorClock vc;
+  for (const auto& pair : entries) {
+    vc.insert(pair.first, MaxLattice<unsigned>(pair.second));
+  }
+  return vc;
+}
+
+SingleKey single(const map<string, unsigned>& entries, const string& value) {
+  return SingleKey(VectorClockValuePair<Strings>(
+      clock(entries), Strings(set<string>({value}))));
+}
+
+MultiKey multi(const map<string, unsigned>& entries, const string& value) {
+  Dependencies deps;
+  deps.insert("dep_" + value, clock(entries));
+  return MultiKey(MultiKeyCausalPayload<Strings>(
+      clock(entries), deps, Strings(set<string>({value}))));
+}
+
+// The merge the causal lattices used to run: merge the clocks, then take the
+// incoming value if the result equals the incoming clock, and merge the
+// values if it differs from the local clock.
+VectorClockValuePair<Strings> reference_merge(
+    VectorClockValuePair<Strings> local,
+    const VectorClockValuePair<Strings>& incoming) {
+  VectorClock prev = local.vector_clock;
+  local.vector_clock.merge(incoming.vector_clock);
+
+  if (local.vector_clock == incoming.vector_clock) {
+    local.value.assign(incoming.value);
+  } else if (!(local.vector_clock == prev)) {
+    local.value.merge(incoming.value);
+  }
+  return local;
+}
+
+// Merges incoming into local both by copy and by move, and checks that the
+// two agree before returning the result.
+template <typename L>
+L merged(const L& local, const L& incoming) {
+  L copied = local;
+  copied.merge(incoming);
+
+  L moved = local;
+  L source = incoming;
+  moved.merge(std::move(source));
+
+  EXPECT_EQ(copied.reveal().vector_clock.reveal(),
+            moved.reveal().vector_clock.reveal());
+  EXPECT_EQ(copied.reveal().value.reveal(), moved.reveal().value.reveal());
+  return copied;
+}
+
+}  // namespace
+
+TEST(CausalLatticeTest, SingleKeyDominatingVersionReplacesLocal) {
+  SingleKey result = merged(single({{"a", 1}}, "old"),
+                            single({{"a", 2}, {"b", 1}}, "new"));
+  EXPECT_EQ(set<string>({"new"}), result.reveal().value.reveal());
+  EXPECT_EQ(clock({{"a", 2}, {"b", 1}}).reveal(),
+            result.reveal().vector_clock.reveal());
+}
+
+TEST(CausalLatticeTest, SingleKeyDominatedVersionIsIgnored) {
+  SingleKey result = merged(single({{"a", 2}, {"b", 1}}, "new"),
+                            single({{"a", 1}}, "old"));
+  EXPECT_EQ(set<string>({"new"}), result.reveal().value.reveal());
+  EXPECT_EQ(clock({{"a", 2}, {"b", 1}}).reveal(),
+            result.reveal().vector_clock.reveal());
+}
+
+TEST(CausalLatticeTest, SingleKeyEqualVersionIsTaken) {
+  SingleKey result =
+      merged(single({{"a", 1}}, "local"), single({{"a", 1}}, "incoming"));
+  EXPECT_EQ(set<string>({"incoming"}), result.reveal().value.reveal());
+}
+
+TEST(CausalLatticeTest, SingleKeyConcurrentVersionsAreMerged) {
+  SingleKey result = merged(single({{"a", 2}, {"b", 1}}, "x"),
+                            single({{"a", 1}, {"b", 2}}, "y"));
+  EXPECT_EQ(set<string>({"x", "y"}), result.reveal().value.reveal());
+  EXPECT_EQ(clock({{"a", 2}, {"b", 2}}).reveal(),
+            result.reveal().vector_clock.reveal());
+}
+
+TEST(CausalLatticeTest, ExplicitZeroEntryKeepsTheLocalVersion) {
+  // the clocks order as equal, but only the local one has an entry for b
+  SingleKey result = merged(single({{"a", 1}, {"b", 0}}, "local"),
+                            single({{"a", 1}}, "incoming"));
+  EXPECT_EQ(set<string>({"local"}), result.reveal().value.reveal());
+  EXPECT_EQ(clock({{"a", 1}, {"b", 0}}).reveal(),
+            result.reveal().vector_clock.reveal());
+
+  // and the other way around, the incoming version is taken
+  result = merged(single({{"a", 1}}, "incoming"),
+                  single({{"a", 1}, {"b", 0}}, "local"));
+  EXPECT_EQ(set<string>({"local"}), result.reveal().value.reveal());
+}
+
+TEST(CausalLatticeTest, MultiKeyDominatingVersionReplacesLocal) {
+  MultiKey result =
+      merged(multi({{"a", 1}}, "old"), multi({{"a", 2}}, "new"));
+  EXPECT_EQ(set<string>({"new"}), result.reveal().value.reveal());
+  EXPECT_EQ(1, result.reveal().dependencies.reveal().size());
+  EXPECT_EQ(1, result.reveal().dependencies.reveal().count("dep_new"));
+}
+
+TEST(CausalLatticeTest, MultiKeyDominatedVersionIsIgnored) {
+  MultiKey result =
+      merged(multi({{"a", 2}}, "new"), multi({{"a", 1}}, "old"));
+  EXPECT_EQ(set<string>({"new"}), result.reveal().value.reveal());
+  EXPECT_EQ(1, result.reveal().dependencies.reveal().count("dep_new"));
+  EXPECT_EQ(0, result.reveal().dependencies.reveal().count("dep_old"));
+}
+
+TEST(CausalLatticeTest, MultiKeyEqualVersionIsTaken) {
+  MultiKey result =
+      merged(multi({{"a", 1}}, "local"), multi({{"a", 1}}, "incoming"));
+  EXPECT_EQ(set<string>({"incoming"}), result.reveal().value.reveal());
+  EXPECT_EQ(0, result.reveal().dependencies.reveal().count("dep_local"));
+}
+
+TEST(CausalLatticeTest, MultiKeyConcurrentVersionsAreMerged) {
+  MultiKey result = merged(multi({{"a", 2}, {"b", 1}}, "x"),
+                           multi({{"a", 1}, {"b", 2}}, "y"));
+  EXPECT_EQ(set<string>({"x", "y"}), result.reveal().value.reveal());
+  EXPECT_EQ(2, result.reveal().dependencies.reveal().size());
+  EXPECT_EQ(clock({{"a", 2}, {"b", 2}}).reveal(),
+            result.reveal().vector_clock.reveal());
+}
+
+TEST(CausalLatticeTest, MatchesMergeThenCompare) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<unsigned> count(0, 2);
+  std::bernoulli_distribution present(0.6);
+  const vector<string> nodes = {"a", "b", "c"};
+
+  for (unsigned i = 0; i < 2000; i++) {
+    map<string, unsigned> local, incoming;
+    for (const string& node : nodes) {
+      if (present(rng)) local[node] = count(rng);
+      if (present(rng)) incoming[node] = count(rng);
+    }
+
+    SingleKey lhs = single(local, "local");
+    SingleKey rhs = single(incoming, "incoming");
+    VectorClockValuePair<Strings> expected =
+        reference_merge(lhs.reveal(), rhs.reveal());
+    SingleKey result = merged(lhs, rhs);
+
+    EXPECT_EQ(expected.vector_clock.reveal(),
+              result.reveal().vector_clock.reveal());
+    EXPECT_EQ(expected.value.reveal(), result.reveal().value.reveal());
+  }
+}
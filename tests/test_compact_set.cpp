@@ -0,0 +1,107 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "common.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+
+// More than one block of strings that share long prefixes, plus the empty
+// string, which sorts first.
+ordered_set<string> make_values() {
+  ordered_set<string> values = {""};
+  for (unsigned i = 0; i < 3 * kCompactSetBlockSize + 5; i++) {
+    values.insert("user/profile/" + std::to_string(i * 37));
+  }
+  return values;
+}
+
+string serialize_set_value(const ordered_set<string>& values) {
+  SetValue s;
+  for (const string& value : values) {
+    s.add_values(value);
+  }
+
+  string serialized;
+  s.SerializeToString(&serialized);
+  return serialized;
+}
+
+}  // namespace
+
+TEST(CompactSetTest, OrderedSetRoundTrip) {
+  OrderedSetLattice<string> lattice(make_values());
+  string serialized = serialize_compact(lattice);
+
+  EXPECT_EQ(kCompactSetMarker, serialized[0]);
+  EXPECT_EQ(lattice.reveal(), deserialize_ordered_set(serialized).reveal());
+}
+
+TEST(CompactSetTest, SetRoundTrip) {
+  ordered_set<string> values = make_values();
+  SetLattice<string> lattice(set<string>(values.begin(), values.end()));
+
+  EXPECT_EQ(lattice.reveal(),
+            deserialize_set(serialize_compact(lattice)).reveal());
+}
+
+TEST(CompactSetTest, EmptySetRoundTrip) {
+  EXPECT_TRUE(deserialize_set(serialize_compact(SetLattice<string>()))
+                  .reveal()
+                  .empty());
+}
+
+TEST(CompactSetTest, SmallerThanSetValue) {
+  ordered_set<string> values = make_values();
+  EXPECT_LT(serialize_compact(OrderedSetLattice<string>(values)).size(),
+            serialize_set_value(values).size());
+}
+
+TEST(CompactSetTest, SetValueStillDecodes) {
+  ordered_set<string> values = make_values();
+  EXPECT_EQ(values,
+            deserialize_ordered_set(serialize_set_value(values)).reveal());
+}
+
+TEST(CompactSetTest, TruncatedPayloadDecodesToEmptySet) {
+  string serialized =
+      serialize_compact(OrderedSetLattice<string>(make_values()));
+
+  for (size_t size :
+       {size_t(1), serialized.size() / 2, serialized.size() - 1}) {
+    string truncated = serialized.substr(0, size);
+    EXPECT_TRUE(deserialize_set(truncated).reveal().empty());
+    EXPECT_TRUE(deserialize_ordered_set(truncated).reveal().empty());
+  }
+}
+
+TEST(CompactSetTest, TrailingBytesDecodeToEmptySet) {
+  string serialized =
+      serialize_compact(OrderedSetLattice<string>(make_values()));
+  serialized += "x";
+
+  EXPECT_TRUE(deserialize_ordered_set(serialized).reveal().empty());
+}
+
+TEST(CompactSetTest, OverlongPrefixDecodesToEmptySet) {
+  // two strings in one block; the second claims to share 5 bytes with a
+  // 1-byte predecessor
+  string serialized(1, kCompactSetMarker);
+  append_varint(&serialized, 2);
+  string block("\x01" "a" "\x05" "\x00", 4);
+  append_varint(&serialized, block.size());
+  serialized += block;
+
+  EXPECT_TRUE(deserialize_set(serialized).reveal().empty());
+}
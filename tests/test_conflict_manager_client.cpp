@@ -0,0 +1,133 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "conflict_manager_client/conflict_manager_client.cpp"
+#include "fake_zmq_util.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+
+// the order in which the client first receives on its sockets
+const unsigned kGetSocket = 0;
+const unsigned kVersionSocket = 1;
+const unsigned kCommitSocket = 2;
+
+class ConflictManagerClientTest : public ::testing::Test {
+ protected:
+  ConflictManagerClientTest() {
+    kFakeZmqUtil.reset();
+    client_.reset(new ConflictManagerClient(
+        {ConflictManagerThread("127.0.0.1", 0)}, "127.0.0.1"));
+
+    // register the receiving sockets in a known order
+    client_->receive_async();
+    client_->receive_commit_async();
+  }
+
+  ~ConflictManagerClientTest() {
+    client_.reset();
+    spdlog::drop_all();
+  }
+
+  // Answers the last request sent the way a conflict manager that predates
+  // request_rid does: with the string id only.
+  KeyResponse legacy_key_response(const string& value) {
+    KeyRequest request =
+        kFakeZmqUtil.sent<KeyRequest>(kFakeZmqUtil.sent_count() - 1);
+    KeyResponse response;
+    response.set_type(request.type());
+    response.set_response_id(request.request_id());
+    for (const auto& tuple : request.tuples()) {
+      KeyTuple* answer = response.add_tuples();
+      answer->set_key(tuple.key());
+      answer->set_payload(value);
+    }
+    return response;
+  }
+
+  std::unique_ptr<ConflictManagerClient> client_;
+};
+
+}  // namespace
+
+TEST_F(ConflictManagerClientTest, GetResponseWithoutRidIsMatched) {
+  client_->get_key_async("a", 5);
+  kFakeZmqUtil.deliver(kGetSocket, legacy_key_response("value"));
+
+  vector<KeyResponse> responses = client_->receive_async();
+  ASSERT_EQ(1, responses.size());
+  ASSERT_EQ(1, responses[0].tuples_size());
+  EXPECT_EQ("a", responses[0].tuples(0).key());
+  EXPECT_EQ("value", responses[0].tuples(0).payload());
+}
+
+TEST_F(ConflictManagerClientTest, VersionResponseWithoutRidIsMatched) {
+  client_->get_key_version_async("a", 5);
+  kFakeZmqUtil.deliver(kVersionSocket, legacy_key_response("3"));
+
+  vector<KeyResponse> responses = client_->receive_async();
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ("3", responses[0].tuples(0).payload());
+}
+
+TEST_F(ConflictManagerClientTest, LegacyResponsesSharingAnIdMatchInOrder) {
+  // both requests belong to the transaction at snapshot 5, so they carry the
+  // same string id
+  client_->get_key_async("a", 5);
+  KeyResponse first = legacy_key_response("1");
+  client_->get_key_async("b", 5);
+  KeyResponse second = legacy_key_response("2");
+
+  kFakeZmqUtil.deliver(kGetSocket, first);
+  kFakeZmqUtil.deliver(kGetSocket, second);
+
+  vector<KeyResponse> responses = client_->receive_async();
+  ASSERT_EQ(2, responses.size());
+  EXPECT_EQ("a", responses[0].tuples(0).key());
+  EXPECT_EQ("b", responses[1].tuples(0).key());
+}
+
+TEST_F(ConflictManagerClientTest, CommitResponseWithoutRidIsMatched) {
+  client_->commit_async({"a"}, {"value"}, LatticeType::LWW, 5);
+  CommitRequest request =
+      kFakeZmqUtil.sent<CommitRequest>(kFakeZmqUtil.sent_count() - 1);
+
+  CommitResponse response;
+  response.set_response_id(request.request_id());
+  response.set_commit_time(7);
+  response.add_committed_keys("a");
+  kFakeZmqUtil.deliver(kCommitSocket, response);
+
+  vector<CommitResponse> responses = client_->receive_commit_async();
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ(7, responses[0].commit_time());
+  EXPECT_EQ(request.request_rid(), responses[0].response_rid());
+}
+
+TEST_F(ConflictManagerClientTest, ResponseRidTakesPrecedence) {
+  client_->get_key_async("a", 5);
+  KeyRequest first = kFakeZmqUtil.sent<KeyRequest>(0);
+  client_->get_key_async("b", 5);
+
+  // a legacy match would pick the older request, for "a"
+  KeyResponse response = legacy_key_response("2");
+  response.set_response_rid(
+      kFakeZmqUtil.sent<KeyRequest>(1).request_rid());
+  kFakeZmqUtil.deliver(kGetSocket, response);
+
+  vector<KeyResponse> responses = client_->receive_async();
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ("b", responses[0].tuples(0).key());
+  EXPECT_NE(first.request_rid(), responses[0].response_rid());
+}
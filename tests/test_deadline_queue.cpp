@@ -0,0 +1,91 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "deadline_queue.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+
+const Deadline kStart = SteadyClock::now();
+
+Deadline at(unsigned ms) { return kStart + std::chrono::milliseconds(ms); }
+
+}  // namespace
+
+TEST(DeadlineQueueTest, ExpiresInDeadlineOrder) {
+  DeadlineQueue<Key> timer;
+  timer.schedule("b", at(20));
+  timer.schedule("a", at(10));
+  timer.schedule("c", at(30));
+
+  EXPECT_EQ(vector<Key>({"a", "b"}), timer.expire(at(20)));
+  EXPECT_EQ(1, timer.size());
+  EXPECT_TRUE(timer.contains("c"));
+}
+
+TEST(DeadlineQueueTest, CancelledIdNeverExpires) {
+  DeadlineQueue<Key> timer;
+  timer.schedule("a", at(10));
+  timer.schedule("b", at(10));
+  timer.cancel("b");
+
+  EXPECT_FALSE(timer.contains("b"));
+  EXPECT_EQ(vector<Key>({"a"}), timer.expire(at(10)));
+  EXPECT_TRUE(timer.empty());
+}
+
+TEST(DeadlineQueueTest, RescheduleReplacesDeadline) {
+  DeadlineQueue<Key> timer;
+  timer.schedule("a", at(10));
+  timer.schedule("a", at(30));
+
+  EXPECT_TRUE(timer.expire(at(20)).empty());
+  EXPECT_EQ(vector<Key>({"a"}), timer.expire(at(30)));
+}
+
+TEST(DeadlineQueueTest, NextDeadlineSkipsStaleEntries) {
+  DeadlineQueue<Key> timer;
+  Deadline next;
+  EXPECT_FALSE(timer.next_deadline(&next));
+
+  timer.schedule("a", at(10));
+  timer.schedule("b", at(20));
+  timer.cancel("a");
+
+  ASSERT_TRUE(timer.next_deadline(&next));
+  EXPECT_EQ(at(20), next);
+}
+
+TEST(DeadlineQueueTest, CapWaitRoundsUpToTheNextDeadline) {
+  DeadlineQueue<Key> timer;
+  auto max_wait = std::chrono::milliseconds(100);
+  EXPECT_EQ(max_wait, timer.cap_wait(at(0), max_wait));
+
+  timer.schedule("a", at(10) + std::chrono::microseconds(500));
+  EXPECT_EQ(std::chrono::milliseconds(11), timer.cap_wait(at(0), max_wait));
+  EXPECT_EQ(std::chrono::milliseconds(0), timer.cap_wait(at(20), max_wait));
+  EXPECT_EQ(std::chrono::milliseconds(5),
+            timer.cap_wait(at(0), std::chrono::milliseconds(5)));
+}
+
+TEST(DeadlineQueueTest, ClearDropsEverything) {
+  DeadlineQueue<Key> timer;
+  timer.schedule("a", at(10));
+  timer.clear();
+
+  Deadline next;
+  EXPECT_TRUE(timer.empty());
+  EXPECT_FALSE(timer.next_deadline(&next));
+  EXPECT_TRUE(timer.expire(at(10)).empty());
+}
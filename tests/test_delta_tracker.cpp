@@ -0,0 +1,95 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "common.hpp"
+#include "gtest/gtest.h"
+
+using Strings = SetLattice<string>;
+using Counters = MapLattice<Key, MaxLattice<unsigned>>;
+
+TEST(DeltaTrackerTest, LocalInsertsAreRecorded) {
+  DeltaTracker<Strings> tracker;
+  EXPECT_FALSE(tracker.has_delta());
+
+  tracker.insert("a");
+  tracker.insert("b");
+
+  EXPECT_TRUE(tracker.has_delta());
+  EXPECT_EQ(set<string>({"a", "b"}), tracker.delta().reveal());
+  EXPECT_EQ(set<string>({"a", "b"}), tracker.state().reveal());
+}
+
+TEST(DeltaTrackerTest, RemoteMergesAreNotRecorded) {
+  DeltaTracker<Strings> tracker(Strings(set<string>({"stored"})));
+  tracker.merge(Strings(set<string>({"remote"})));
+
+  EXPECT_FALSE(tracker.has_delta());
+  EXPECT_TRUE(tracker.delta().reveal().empty());
+  EXPECT_EQ(set<string>({"stored", "remote"}), tracker.state().reveal());
+}
+
+TEST(DeltaTrackerTest, FlushStartsANewDelta) {
+  DeltaTracker<Counters> tracker;
+  tracker.insert("x", MaxLattice<unsigned>(3));
+
+  Counters delta = tracker.flush();
+  EXPECT_EQ(3, delta.reveal().at("x").reveal());
+  EXPECT_FALSE(tracker.has_delta());
+  EXPECT_TRUE(tracker.delta().reveal().empty());
+
+  tracker.update(Counters({{"y", MaxLattice<unsigned>(1)}}));
+  EXPECT_EQ(1, tracker.delta().reveal().size());
+  EXPECT_EQ(2, tracker.state().reveal().size());
+}
+
+TEST(DeltaTrackerTest, RestoredDeltaIsFlushedAgain) {
+  DeltaTracker<Strings> tracker;
+  tracker.insert("a");
+  Strings failed = tracker.flush();
+
+  tracker.insert("b");
+  tracker.restore(std::move(failed));
+
+  EXPECT_TRUE(tracker.has_delta());
+  EXPECT_EQ(set<string>({"a", "b"}), tracker.flush().reveal());
+}
+
+TEST(DeltaTrackerTest, DeltasBringAReplicaUpToDate) {
+  DeltaTracker<Strings> writer;
+  Strings replica;
+
+  for (unsigned round = 0; round < 3; round++) {
+    for (unsigned i = 0; i < 5; i++) {
+      writer.insert("value_" + std::to_string(round * 5 + i));
+    }
+
+    merge_delta(&replica, serialize_delta(&writer));
+    EXPECT_EQ(writer.state().reveal(), replica.reveal());
+  }
+
+  // an empty flush is harmless
+  merge_delta(&replica, serialize_delta(&writer));
+  EXPECT_EQ(15, replica.reveal().size());
+}
+
+TEST(DeltaTrackerTest, OrderedSetDeltasBringAReplicaUpToDate) {
+  DeltaTracker<OrderedSetLattice<string>> writer(
+      OrderedSetLattice<string>(ordered_set<string>({"b"})));
+  OrderedSetLattice<string> replica(ordered_set<string>({"b"}));
+
+  writer.insert("c");
+  writer.insert("a");
+  merge_delta(&replica, serialize_delta(&writer));
+  EXPECT_EQ(ordered_set<string>({"a", "b", "c"}), replica.reveal());
+}
@@ -0,0 +1,153 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include "flat_hash_map.hpp"
+#include "gtest/gtest.h"
+
+using StringMap = FlatHashMap<std::string, int>;
+
+// A hash that sends every key to the same probe sequence, so that lookups
+// have to step over collisions and tombstones.
+struct CollidingHash {
+  std::size_t operator()(int) const { return 0; }
+};
+
+TEST(FlatHashMapTest, InsertFindErase) {
+  StringMap map;
+  EXPECT_TRUE(map.empty());
+
+  EXPECT_TRUE(map.emplace("a", 1).second);
+  EXPECT_FALSE(map.emplace("a", 2).second);
+  map["b"] = 3;
+
+  EXPECT_EQ(2, map.size());
+  EXPECT_EQ(1, map.find("a")->second);
+  EXPECT_EQ(3, map["b"]);
+  EXPECT_EQ(map.end(), map.find("c"));
+
+  EXPECT_EQ(1, map.erase("a"));
+  EXPECT_EQ(0, map.erase("a"));
+  EXPECT_EQ(0, map.count("a"));
+  EXPECT_EQ(1, map.size());
+}
+
+TEST(FlatHashMapTest, GrowsPastManyRehashes) {
+  FlatHashMap<int, int> map;
+  for (int i = 0; i < 10000; i++) {
+    map[i] = i * 2;
+  }
+
+  EXPECT_EQ(10000, map.size());
+  for (int i = 0; i < 10000; i++) {
+    ASSERT_EQ(i * 2, map.find(i)->second);
+  }
+}
+
+TEST(FlatHashMapTest, ErasedSlotsDoNotHideCollidingKeys) {
+  FlatHashMap<int, int, CollidingHash> map;
+  for (int i = 0; i < 8; i++) {
+    map[i] = i;
+  }
+
+  // every other key leaves a tombstone in the middle of the probe sequence
+  for (int i = 0; i < 8; i += 2) {
+    map.erase(i);
+  }
+
+  for (int i = 1; i < 8; i += 2) {
+    ASSERT_NE(map.end(), map.find(i));
+  }
+
+  // reinsertions reuse the tombstones without duplicating live keys
+  for (int i = 0; i < 8; i++) {
+    map[i] = -i;
+  }
+
+  EXPECT_EQ(8, map.size());
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(-i, map.find(i)->second);
+  }
+}
+
+TEST(FlatHashMapTest, EraseDuringIteration) {
+  FlatHashMap<int, int> map;
+  for (int i = 0; i < 100; i++) {
+    map[i] = i;
+  }
+
+  for (auto it = map.begin(); it != map.end();) {
+    if (it->first % 2 == 0) {
+      it = map.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  EXPECT_EQ(50, map.size());
+  unsigned visited = 0;
+  for (const auto& entry : map) {
+    EXPECT_EQ(1, entry.first % 2);
+    visited++;
+  }
+  EXPECT_EQ(50, visited);
+}
+
+TEST(FlatHashMapTest, CopyAndMove) {
+  StringMap map;
+  map["a"] = 1;
+  map["b"] = 2;
+
+  StringMap copy(map);
+  copy["a"] = 10;
+  EXPECT_EQ(1, map["a"]);
+  EXPECT_EQ(10, copy["a"]);
+
+  StringMap moved(std::move(copy));
+  EXPECT_EQ(2, moved.size());
+  EXPECT_EQ(10, moved["a"]);
+
+  map = moved;
+  EXPECT_EQ(10, map["a"]);
+
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.begin(), map.end());
+}
+
+TEST(FlatHashMapTest, MatchesUnorderedMap) {
+  FlatHashMap<unsigned, unsigned> map;
+  std::unordered_map<unsigned, unsigned> expected;
+  std::mt19937 rng(42);
+
+  for (unsigned i = 0; i < 100000; i++) {
+    unsigned key = rng() % 1000;
+    if (rng() % 3 == 0) {
+      EXPECT_EQ(expected.erase(key), map.erase(key));
+    } else {
+      expected[key] = i;
+      map[key] = i;
+    }
+  }
+
+  ASSERT_EQ(expected.size(), map.size());
+  for (const auto& entry : expected) {
+    auto it = map.find(entry.first);
+    ASSERT_NE(map.end(), it);
+    EXPECT_EQ(entry.second, it->second);
+  }
+}
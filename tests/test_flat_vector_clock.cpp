@@ -0,0 +1,165 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <thread>
+
+#include "common.hpp"
+#include "gtest/gtest.h"
+#include "lattices/flat_vector_clock.hpp"
+
+TEST(FlatVectorClockTest, UnknownNodeIsNotInterned) {
+  FlatVectorClock clock;
+  clock.insert("flat_vc_known", 4);
+
+  EXPECT_EQ(4, clock.at("flat_vc_known"));
+  EXPECT_EQ(0, clock.at("flat_vc_unknown"));
+
+  NodeId id;
+  EXPECT_TRUE(NodeIdTable::get().find("flat_vc_known", &id));
+  EXPECT_FALSE(NodeIdTable::get().find("flat_vc_unknown", &id));
+}
+
+TEST(FlatVectorClockTest, MatchesVectorClock) {
+  VectorClock vc;
+  vc.insert("flat_vc_a", MaxLattice<unsigned>(2));
+  vc.insert("flat_vc_b", MaxLattice<unsigned>(5));
+
+  FlatVectorClock clock(vc);
+  EXPECT_EQ(2, clock.at("flat_vc_a"));
+  EXPECT_EQ(5, clock.at("flat_vc_b"));
+  EXPECT_EQ(vc.reveal(), clock.to_vector_clock().reveal());
+
+  FlatVectorClock ahead(vc);
+  ahead.insert("flat_vc_a", 3);
+  EXPECT_EQ(ClockOrder::GREATER, compare(ahead, clock));
+  EXPECT_EQ(ClockOrder::LESS, compare(clock, ahead));
+
+  ahead.insert("flat_vc_c", 0);
+  clock.insert("flat_vc_b", 6);
+  EXPECT_EQ(ClockOrder::CONCURRENT, compare(ahead, clock));
+}
+
+TEST(FlatVectorClockTest, CompareDisjointNodes) {
+  FlatVectorClock a, b;
+  a.insert("flat_vc_disjoint_a", 1);
+  b.insert("flat_vc_disjoint_b", 1);
+
+  EXPECT_EQ(ClockOrder::CONCURRENT, a.compare_to(b));
+  EXPECT_TRUE(a.concurrent_with(b));
+  EXPECT_FALSE(a.dominates(b));
+  EXPECT_FALSE(b.dominates(a));
+
+  // a missing entry counts as 0
+  FlatVectorClock zero;
+  zero.insert("flat_vc_disjoint_b", 0);
+  EXPECT_EQ(ClockOrder::GREATER, a.compare_to(zero));
+  EXPECT_TRUE(a.dominates(zero));
+  EXPECT_FALSE(zero.dominates(a));
+  EXPECT_FALSE(a.concurrent_with(zero));
+
+  EXPECT_EQ(ClockOrder::LESS, FlatVectorClock().compare_to(a));
+}
+
+TEST(FlatVectorClockTest, CompareInterleavedNodes) {
+  // intern in order, so that the two clocks' IDs interleave
+  NodeIdTable &table = NodeIdTable::get();
+  NodeId n1 = table.intern("flat_vc_interleaved_1");
+  NodeId n2 = table.intern("flat_vc_interleaved_2");
+  NodeId n3 = table.intern("flat_vc_interleaved_3");
+  NodeId n4 = table.intern("flat_vc_interleaved_4");
+
+  FlatVectorClock a, b;
+  a.insert(n1, 1);
+  a.insert(n3, 3);
+  b.insert(n2, 2);
+  b.insert(n4, 4);
+  EXPECT_TRUE(a.concurrent_with(b));
+  EXPECT_FALSE(a.dominates(b));
+  EXPECT_FALSE(b.dominates(a));
+
+  a.insert(n2, 2);
+  a.insert(n4, 4);
+  EXPECT_EQ(ClockOrder::GREATER, a.compare_to(b));
+  EXPECT_TRUE(a.dominates(b));
+  EXPECT_FALSE(b.dominates(a));
+  EXPECT_FALSE(a.concurrent_with(b));
+
+  b.insert(n3, 3);
+  b.insert(n1, 1);
+  EXPECT_EQ(ClockOrder::EQUAL, a.compare_to(b));
+  EXPECT_TRUE(a.dominates(b));
+  EXPECT_TRUE(b.dominates(a));
+
+  b.insert(n3, 5);
+  a.insert(n1, 2);
+  EXPECT_TRUE(a.concurrent_with(b));
+}
+
+TEST(FlatVectorClockTest, ProtoRoundTrip) {
+  google::protobuf::Map<string, uint32_t> proto_clock;
+  proto_clock["flat_vc_proto_a"] = 1;
+  proto_clock["flat_vc_proto_b"] = 7;
+  proto_clock["flat_vc_proto_c"] = 3;
+
+  FlatVectorClock clock = to_flat_vector_clock(proto_clock);
+  EXPECT_EQ(3, clock.size().reveal());
+  EXPECT_EQ(1, clock.at("flat_vc_proto_a"));
+  EXPECT_EQ(7, clock.at("flat_vc_proto_b"));
+  EXPECT_EQ(3, clock.at("flat_vc_proto_c"));
+
+  google::protobuf::Map<string, uint32_t> round_trip;
+  to_proto_vector_clock(clock, &round_trip);
+  ASSERT_EQ(proto_clock.size(), round_trip.size());
+  for (const auto &pair : proto_clock) {
+    EXPECT_EQ(pair.second, round_trip.at(pair.first));
+  }
+
+  EXPECT_EQ(clock.reveal(), to_flat_vector_clock(round_trip).reveal());
+}
+
+TEST(FlatVectorClockTest, ThreadsAgreeOnIds) {
+  const unsigned kThreads = 4;
+  const unsigned kNames = 64;
+  vector<vector<NodeId>> ids(kThreads, vector<NodeId>(kNames));
+
+  vector<std::thread> threads;
+  for (unsigned t = 0; t < kThreads; t++) {
+    threads.emplace_back([t, &ids]() {
+      NodeIdTable &table = NodeIdTable::get();
+
+      // each thread interns the names in a different order
+      for (unsigned i = 0; i < kNames; i++) {
+        unsigned n = (i + t * kNames / kThreads) % kNames;
+        ids[t][n] = table.intern("flat_vc_thread_" + std::to_string(n));
+      }
+    });
+  }
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  NodeIdTable &table = NodeIdTable::get();
+  for (unsigned n = 0; n < kNames; n++) {
+    string name = "flat_vc_thread_" + std::to_string(n);
+    for (unsigned t = 1; t < kThreads; t++) {
+      EXPECT_EQ(ids[0][n], ids[t][n]);
+    }
+
+    NodeId id;
+    EXPECT_TRUE(table.find(name, &id));
+    EXPECT_EQ(ids[0][n], id);
+    EXPECT_EQ(name, table.name(id));
+  }
+}
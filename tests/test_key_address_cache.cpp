@@ -0,0 +1,127 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <thread>
+
+#include "key_address_cache.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+
+const Address kWorkerA = "tcp://10.0.0.1:6200";
+const Address kWorkerA2 = "tcp://10.0.0.1:6201";
+const Address kWorkerB = "tcp://10.0.0.2:6200";
+
+const std::chrono::milliseconds kTtl(20);
+
+void wait_for_expiry() {
+  std::this_thread::sleep_for(kTtl + std::chrono::milliseconds(10));
+}
+
+}  // namespace
+
+TEST(KeyAddressCacheTest, CountsHitsAndMisses) {
+  KeyAddressCache cache;
+  EXPECT_EQ(nullptr, cache.get("a"));
+
+  cache.add("a", kWorkerA);
+  const set<Address>* addresses = cache.get("a");
+  ASSERT_NE(nullptr, addresses);
+  EXPECT_EQ(set<Address>({kWorkerA}), *addresses);
+
+  // peek and address_count are not lookups
+  EXPECT_NE(nullptr, cache.peek("a"));
+  EXPECT_EQ(1, cache.address_count("a"));
+  EXPECT_EQ(0, cache.address_count("b"));
+
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+}
+
+TEST(KeyAddressCacheTest, LookupsGiveKeysASecondChance) {
+  KeyAddressCache cache(3);
+  cache.add("a", kWorkerA);
+  cache.add("b", kWorkerA);
+  cache.add("c", kWorkerA);
+
+  // the first sweep clears every mark and evicts the oldest key
+  cache.add("d", kWorkerA);
+  EXPECT_EQ(3, cache.size());
+  EXPECT_EQ(1, cache.evictions());
+  EXPECT_EQ(nullptr, cache.peek("a"));
+
+  // b is looked up again, so c goes before it
+  ASSERT_NE(nullptr, cache.get("b"));
+  cache.add("e", kWorkerA);
+  EXPECT_NE(nullptr, cache.peek("b"));
+  EXPECT_EQ(nullptr, cache.peek("c"));
+  EXPECT_EQ(2, cache.evictions());
+}
+
+TEST(KeyAddressCacheTest, InvalidatesEveryKeyOnANode) {
+  KeyAddressCache cache;
+  cache.add("a", kWorkerA);
+  cache.add("b", kWorkerA2);
+  cache.add("c", kWorkerB);
+
+  cache.invalidate_node(kWorkerA);
+  EXPECT_EQ(nullptr, cache.peek("a"));
+  EXPECT_EQ(nullptr, cache.peek("b"));
+  EXPECT_NE(nullptr, cache.peek("c"));
+  EXPECT_EQ(1, cache.size());
+}
+
+TEST(KeyAddressCacheTest, ExpiredEntryIsAMiss) {
+  KeyAddressCache cache(10, kTtl);
+  cache.add("a", kWorkerA);
+  wait_for_expiry();
+
+  EXPECT_EQ(nullptr, cache.get("a"));
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+  EXPECT_EQ(1, cache.expirations());
+  EXPECT_EQ(0, cache.size());
+}
+
+TEST(KeyAddressCacheTest, PeekTreatsExpiredEntryAsMissing) {
+  KeyAddressCache cache(10, kTtl);
+  cache.add("a", kWorkerA);
+  EXPECT_EQ(1, cache.address_count("a"));
+  wait_for_expiry();
+
+  EXPECT_EQ(nullptr, cache.peek("a"));
+  EXPECT_EQ(0, cache.address_count("a"));
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(0, cache.misses());
+}
+
+TEST(KeyAddressCacheTest, AddingToExpiredEntryStartsItOver) {
+  KeyAddressCache cache(10, kTtl);
+  cache.add("a", kWorkerA);
+  wait_for_expiry();
+
+  cache.add("a", kWorkerB);
+  const set<Address>* addresses = cache.get("a");
+  ASSERT_NE(nullptr, addresses);
+  EXPECT_EQ(set<Address>({kWorkerB}), *addresses);
+  EXPECT_EQ(1, cache.expirations());
+
+  // the stale address no longer ties the key to its node
+  cache.invalidate_node(kWorkerA);
+  EXPECT_NE(nullptr, cache.peek("a"));
+
+  // and the refreshed entry gets a full time to live
+  std::this_thread::sleep_for(kTtl / 2);
+  EXPECT_NE(nullptr, cache.peek("a"));
+}
@@ -0,0 +1,170 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <thread>
+
+#include "client/kvs_client.hpp"
+#include "fake_zmq_util.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+
+// the order in which the client first receives on its sockets
+const unsigned kKeyAddressSocket = 0;
+const unsigned kResponseSocket = 1;
+
+const Address kWorker = "tcp://127.0.0.1:6200";
+
+class KvsClientTest : public ::testing::Test {
+ protected:
+  KvsClientTest() { start_client(10000); }
+
+  // Replaces the client with a new one whose requests time out after
+  // timeout ms.
+  void start_client(unsigned timeout) {
+    client_.reset();
+    spdlog::drop_all();
+    kFakeZmqUtil.reset();
+    client_.reset(new KvsClient({UserRoutingThread("127.0.0.1", 0)},
+                                "127.0.0.1", 0, timeout));
+
+    // register the receiving sockets in a known order
+    client_->receive_async();
+  }
+
+  ~KvsClientTest() {
+    client_.reset();
+    spdlog::drop_all();
+  }
+
+  // Tells the client that kWorker is responsible for each of keys.
+  void deliver_addresses(const vector<Key>& keys) {
+    KeyAddressResponse response;
+    for (const Key& key : keys) {
+      KeyAddressResponse::KeyAddress* address = response.add_addresses();
+      address->set_key(key);
+      address->add_ips(kWorker);
+    }
+    kFakeZmqUtil.deliver(kKeyAddressSocket, response);
+  }
+
+  std::unique_ptr<KvsClient> client_;
+};
+
+}  // namespace
+
+TEST_F(KvsClientTest, PutBatchWithDuplicateKeyIsRejected) {
+  EXPECT_THROW(client_->put_batch_async({"a", "b", "a"}, {"1", "2", "3"},
+                                        LatticeType::LWW),
+               std::invalid_argument);
+
+  // nothing was sent or left pending
+  EXPECT_EQ(0, kFakeZmqUtil.sent_count());
+  EXPECT_TRUE(client_->receive_async().empty());
+}
+
+TEST_F(KvsClientTest, PutBatchWithMismatchedPayloadsIsRejected) {
+  EXPECT_THROW(
+      client_->put_batch_async({"a", "b"}, {"1"}, LatticeType::LWW),
+      std::invalid_argument);
+  EXPECT_THROW(
+      client_->put_batch_async({"a"}, {"1", "2"}, LatticeType::LWW),
+      std::invalid_argument);
+
+  // nothing was sent or left pending
+  EXPECT_EQ(0, kFakeZmqUtil.sent_count());
+  EXPECT_TRUE(client_->receive_async().empty());
+}
+
+TEST_F(KvsClientTest, PutBatchGetsOneResponsePerKey) {
+  string request_id =
+      client_->put_batch_async({"a", "b"}, {"1", "2"}, LatticeType::LWW);
+  deliver_addresses({"a", "b"});
+  EXPECT_TRUE(client_->receive_async().empty());
+
+  // the worker answers both keys in a single response
+  KeyResponse response;
+  response.set_type(RequestType::PUT);
+  response.set_response_id(request_id);
+  response.add_tuples()->set_key("a");
+  response.add_tuples()->set_key("b");
+  kFakeZmqUtil.deliver(kResponseSocket, response);
+
+  vector<KeyResponse> responses = client_->receive_async();
+  ASSERT_EQ(2, responses.size());
+  set<Key> keys;
+  for (const KeyResponse& single : responses) {
+    ASSERT_EQ(1, single.tuples_size());
+    EXPECT_EQ(request_id, single.response_id());
+    keys.insert(single.tuples(0).key());
+  }
+  EXPECT_EQ(set<Key>({"a", "b"}), keys);
+}
+
+TEST_F(KvsClientTest, PutReturnsTheLegacyRequestId) {
+  string request_id = client_->put_async("a", "1", LatticeType::LWW);
+  deliver_addresses({"a"});
+  EXPECT_TRUE(client_->receive_async().empty());
+
+  // a server that only echoes the integer ID
+  KeyResponse response;
+  response.set_type(RequestType::PUT);
+  response.set_response_rid(std::stoull(request_id));
+  response.add_tuples()->set_key("a");
+  kFakeZmqUtil.deliver(kResponseSocket, response);
+
+  vector<KeyResponse> responses = client_->receive_async();
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ(request_id, responses[0].response_id());
+}
+
+TEST_F(KvsClientTest, TimedOutPutCarriesTheLegacyRequestId) {
+  start_client(10);
+  string request_id = client_->put_async("a", "1", LatticeType::LWW);
+  deliver_addresses({"a"});
+  EXPECT_TRUE(client_->receive_async().empty());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  vector<KeyResponse> responses = client_->receive_async();
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ(AnnaError::TIMEOUT, responses[0].error());
+  EXPECT_EQ(request_id, responses[0].response_id());
+  EXPECT_EQ(std::stoull(request_id), responses[0].response_rid());
+}
+
+TEST_F(KvsClientTest, PutDeltaIsMarkedOnTheTuple) {
+  DeltaTracker<SetLattice<string>> tracker;
+  tracker.insert("x");
+  client_->put_delta_async("a", serialize_delta(&tracker), LatticeType::SET);
+  deliver_addresses({"a"});
+  client_->receive_async();
+
+  ASSERT_LT(0, kFakeZmqUtil.sent_count());
+  KeyRequest request =
+      kFakeZmqUtil.sent<KeyRequest>(kFakeZmqUtil.sent_count() - 1);
+  ASSERT_EQ(1, request.tuples_size());
+  EXPECT_TRUE(request.tuples(0).delta());
+  EXPECT_EQ(set<string>({"x"}),
+            deserialize_set(request.tuples(0).payload()).reveal());
+}
+
+TEST_F(KvsClientTest, PutDeltaRejectsLatticesWithoutDeltas) {
+  EXPECT_THROW(client_->put_delta_async("a", "1", LatticeType::LWW),
+               std::invalid_argument);
+  EXPECT_THROW(client_->put_delta_async("a", "1", LatticeType::SINGLE_CAUSAL),
+               std::invalid_argument);
+
+  EXPECT_EQ(0, kFakeZmqUtil.sent_count());
+  EXPECT_TRUE(client_->receive_async().empty());
+}
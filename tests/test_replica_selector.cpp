@@ -0,0 +1,119 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "replica_selector.hpp"
+
+namespace {
+
+const set<Address> kReplicas = {"a", "b", "c"};
+
+// Counts how often each replica is picked in n selections.
+map<Address, unsigned> pick(const ReplicaSelector& selector, unsigned n) {
+  map<Address, unsigned> picks;
+  unsigned seed = 0;
+
+  for (unsigned i = 0; i < n; i++) {
+    picks[selector.select(kReplicas, &seed)]++;
+  }
+
+  return picks;
+}
+
+void answer_all(ReplicaSelector* selector, std::chrono::microseconds latency) {
+  for (const Address& replica : kReplicas) {
+    selector->on_send(replica);
+    selector->on_response(replica, latency);
+  }
+}
+
+}  // namespace
+
+TEST(ReplicaSelectorTest, AvoidsSlowReplica) {
+  ReplicaSelector selector(ReplicaPolicy::POWER_OF_TWO_CHOICES);
+  answer_all(&selector, std::chrono::microseconds(100));
+  selector.on_send("a");
+  selector.on_response("a", std::chrono::microseconds(100000));
+
+  map<Address, unsigned> picks = pick(selector, 10000);
+  EXPECT_EQ(picks["a"], 0);
+  EXPECT_GT(picks["b"], 0);
+  EXPECT_GT(picks["c"], 0);
+}
+
+TEST(ReplicaSelectorTest, LeastLoadedPicksCheapest) {
+  ReplicaSelector selector(ReplicaPolicy::LEAST_LOADED);
+  answer_all(&selector, std::chrono::microseconds(100));
+  selector.on_send("a");
+  selector.on_send("b");
+
+  EXPECT_EQ(pick(selector, 100)["c"], 100);
+}
+
+TEST(ReplicaSelectorTest, ExcludedReplicaIsNeverPicked) {
+  ReplicaSelector selector(ReplicaPolicy::RANDOM);
+  unsigned seed = 0;
+
+  for (unsigned i = 0; i < 1000; i++) {
+    EXPECT_NE(selector.select(kReplicas, &seed, "b"), "b");
+  }
+  EXPECT_EQ(selector.select({"b"}, &seed, "b"), "");
+}
+
+TEST(ReplicaSelectorTest, TimedOutReplicaIsPickedAgainOnceThePenaltyDecays) {
+  for (ReplicaPolicy policy :
+       {ReplicaPolicy::POWER_OF_TWO_CHOICES, ReplicaPolicy::LEAST_LOADED}) {
+    ReplicaSelector selector(policy, 0.2, std::chrono::milliseconds(1));
+    answer_all(&selector, std::chrono::microseconds(100));
+    selector.on_send("a");
+    selector.on_timeout("a", std::chrono::seconds(10));
+
+    // right after the timeout, a costs far more than the other replicas
+    EXPECT_EQ(pick(selector, 1000)["a"], 0);
+
+    // 50 half-lives later, the penalty is gone
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    selector.on_send("b");
+    selector.on_send("c");
+    EXPECT_GT(pick(selector, 1000)["a"], 0);
+  }
+}
+
+TEST(ReplicaSelectorTest, ResponseClearsTimeoutPenalty) {
+  ReplicaSelector selector(ReplicaPolicy::LEAST_LOADED);
+  answer_all(&selector, std::chrono::microseconds(100));
+  selector.on_send("a");
+  selector.on_timeout("a", std::chrono::seconds(10));
+  EXPECT_GT(selector.stats("a")->timeout_penalty_, 0);
+
+  selector.on_send("a");
+  selector.on_response("a", std::chrono::microseconds(100));
+  EXPECT_EQ(selector.stats("a")->timeout_penalty_, 0);
+}
+
+TEST(ReplicaSelectorTest, LatencyPercentile) {
+  ReplicaSelector selector;
+  EXPECT_EQ(selector.latency_percentile(0.5).count(), 0);
+
+  for (unsigned i = 1; i <= 100; i++) {
+    selector.on_send("a");
+    selector.on_response("a", std::chrono::microseconds(i));
+  }
+
+  EXPECT_EQ(selector.sample_count(), 100);
+  EXPECT_EQ(selector.latency_percentile(0.5).count(), 51);
+  EXPECT_EQ(selector.latency_percentile(1).count(), 100);
+}
@@ -0,0 +1,137 @@
+//  Copyright 2019 U.C. Berkeley RISE Lab
+//
+//  Licensed under the Apache License, Version 2.0 (the "License");
+//  you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+#include "gtest/gtest.h"
+#include "lattices/core_lattices.hpp"
+
+namespace {
+
+using Strings = SetLattice<string>;
+using OrderedStrings = OrderedSetLattice<string>;
+using Counters = MapLattice<Key, MaxLattice<unsigned>>;
+
+const set<string> kSmall = {"b", "c"};
+const set<string> kLarge = {"a", "b", "d", "e"};
+
+const ordered_set<string> kOrderedSmall = {"b", "c"};
+const ordered_set<string> kOrderedLarge = {"a", "b", "d", "e"};
+
+Counters counters(const map<Key, unsigned>& entries) {
+  Counters result;
+  for (const auto& pair : entries) {
+    result.insert(pair.first, MaxLattice<unsigned>(pair.second));
+  }
+  return result;
+}
+
+map<Key, unsigned> reveal(const Counters& counters) {
+  map<Key, unsigned> result;
+  for (const auto& pair : counters.reveal()) {
+    result[pair.first] = pair.second.reveal();
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(SetLatticeTest, IntersectWithEitherSideSmaller) {
+  set<string> expected = {"b"};
+  EXPECT_EQ(expected, Strings(kSmall).intersect(kLarge).reveal());
+  EXPECT_EQ(expected, Strings(kLarge).intersect(kSmall).reveal());
+  EXPECT_EQ(expected, Strings(kLarge).intersect(Strings(kSmall)).reveal());
+}
+
+TEST(SetLatticeTest, UniteWithEitherSideSmaller) {
+  set<string> expected = {"a", "b", "c", "d", "e"};
+  EXPECT_EQ(expected, Strings(kSmall).unite(kLarge).reveal());
+  EXPECT_EQ(expected, Strings(kLarge).unite(kSmall).reveal());
+  EXPECT_EQ(expected, Strings(kSmall).unite(Strings(kLarge)).reveal());
+}
+
+TEST(SetLatticeTest, DifferenceWithEitherSideSmaller) {
+  EXPECT_EQ(set<string>({"c"}), Strings(kSmall).difference(kLarge).reveal());
+  EXPECT_EQ(set<string>({"a", "d", "e"}),
+            Strings(kLarge).difference(Strings(kSmall)).reveal());
+}
+
+TEST(SetLatticeTest, EmptyOperands) {
+  Strings empty;
+  EXPECT_TRUE(empty.intersect(kLarge).reveal().empty());
+  EXPECT_TRUE(Strings(kLarge).intersect(empty).reveal().empty());
+  EXPECT_EQ(kLarge, empty.unite(kLarge).reveal());
+  EXPECT_EQ(kLarge, Strings(kLarge).unite(empty).reveal());
+  EXPECT_TRUE(empty.difference(kLarge).reveal().empty());
+  EXPECT_EQ(kLarge, Strings(kLarge).difference(empty).reveal());
+  EXPECT_TRUE(empty.unite(empty).reveal().empty());
+}
+
+TEST(SetLatticeTest, OperandMayBeTheSetItself) {
+  Strings strings(kLarge);
+  EXPECT_EQ(kLarge, strings.intersect(strings).reveal());
+  EXPECT_EQ(kLarge, strings.unite(strings).reveal());
+  EXPECT_TRUE(strings.difference(strings).reveal().empty());
+}
+
+TEST(OrderedSetLatticeTest, OperationsWithEitherSideSmaller) {
+  OrderedStrings small(kOrderedSmall), large(kOrderedLarge);
+  EXPECT_EQ(ordered_set<string>({"b"}), small.intersect(large).reveal());
+  EXPECT_EQ(ordered_set<string>({"b"}),
+            large.intersect(kOrderedSmall).reveal());
+  EXPECT_EQ(ordered_set<string>({"a", "b", "c", "d", "e"}),
+            small.unite(large).reveal());
+  EXPECT_EQ(ordered_set<string>({"a", "b", "c", "d", "e"}),
+            large.unite(kOrderedSmall).reveal());
+  EXPECT_EQ(ordered_set<string>({"c"}), small.difference(large).reveal());
+  EXPECT_EQ(ordered_set<string>({"a", "d", "e"}),
+            large.difference(kOrderedSmall).reveal());
+}
+
+TEST(OrderedSetLatticeTest, EmptyOperands) {
+  OrderedStrings empty, large(kOrderedLarge);
+  EXPECT_TRUE(empty.intersect(large).reveal().empty());
+  EXPECT_TRUE(large.intersect(empty).reveal().empty());
+  EXPECT_EQ(kOrderedLarge, empty.unite(large).reveal());
+  EXPECT_EQ(kOrderedLarge, large.unite(empty).reveal());
+  EXPECT_TRUE(empty.difference(large).reveal().empty());
+  EXPECT_EQ(kOrderedLarge, large.difference(empty).reveal());
+}
+
+TEST(MapLatticeTest, IntersectMergesSharedValues) {
+  Counters small = counters({{"a", 5}, {"b", 1}});
+  Counters large = counters({{"a", 2}, {"b", 7}, {"c", 3}, {"d", 4}});
+  map<Key, unsigned> expected = {{"a", 5}, {"b", 7}};
+
+  EXPECT_EQ(expected, reveal(small.intersect(large)));
+  EXPECT_EQ(expected, reveal(large.intersect(small)));
+}
+
+TEST(MapLatticeTest, IntersectMergesSetValues) {
+  MapLattice<Key, Strings> lhs, rhs;
+  lhs.insert("k", Strings(set<string>({"x"})));
+  lhs.insert("only_lhs", Strings(set<string>({"y"})));
+  rhs.insert("k", Strings(set<string>({"z"})));
+
+  MapLattice<Key, Strings> result = lhs.intersect(rhs);
+  ASSERT_EQ(1, result.reveal().size());
+  EXPECT_EQ(set<string>({"x", "z"}), result.reveal().at("k").reveal());
+}
+
+TEST(MapLatticeTest, IntersectWithEmptyOrSelf) {
+  Counters empty;
+  Counters full = counters({{"a", 1}, {"b", 2}});
+
+  EXPECT_TRUE(empty.intersect(full).reveal().empty());
+  EXPECT_TRUE(full.intersect(empty).reveal().empty());
+  EXPECT_EQ(reveal(full), reveal(full.intersect(full)));
+}